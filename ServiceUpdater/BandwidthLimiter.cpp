@@ -0,0 +1,199 @@
+#include "BandwidthLimiter.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include "Logger.h"
+
+using json = nlohmann::json;
+
+namespace {
+    constexpr int kMinutesPerDay = 24 * 60;
+
+    /// Converts kilobits per second to bytes per second.
+    uint64_t KbpsToBytes(uint64_t kbps) {
+        return kbps * 1000 / 8;
+    }
+
+    /// Parses "HH:MM" into minutes since midnight.
+    int ParseTimeOfDay(const std::string& value) {
+        int hours = 0;
+        int minutes = 0;
+        char separator = 0;
+        if (std::sscanf(value.c_str(), "%d%c%d", &hours, &separator, &minutes) != 3 || separator != ':' ||
+            hours < 0 || hours > 24 || minutes < 0 || minutes > 59 || (hours == 24 && minutes != 0)) {
+            throw std::runtime_error("Invalid time of day '" + value + "', expected HH:MM.");
+        }
+        return hours * 60 + minutes;
+    }
+
+    int LocalMinuteOfDay() {
+        std::time_t now = std::time(nullptr);
+        std::tm parts{};
+#ifdef _WIN32
+        localtime_s(&parts, &now);
+#else
+        localtime_r(&now, &parts);
+#endif
+        return parts.tm_hour * 60 + parts.tm_min;
+    }
+
+    BandwidthSchedule ParseSchedule(const json& section) {
+        BandwidthSchedule schedule;
+        schedule.defaultBytesPerSecond = KbpsToBytes(section.value("DefaultKbps", uint64_t{ 0 }));
+
+        for (const auto& entry : section.value("Schedule", json::array())) {
+            BandwidthWindow window;
+            window.startMinute = ParseTimeOfDay(entry.at("From").get<std::string>()) % kMinutesPerDay;
+            window.endMinute = ParseTimeOfDay(entry.at("To").get<std::string>()) % kMinutesPerDay;
+            window.bytesPerSecond = KbpsToBytes(entry.at("Kbps").get<uint64_t>());
+            schedule.windows.push_back(window);
+        }
+        return schedule;
+    }
+}
+
+bool BandwidthWindow::Contains(int minuteOfDay) const {
+    if (startMinute == endMinute) {
+        return true;
+    }
+    if (startMinute < endMinute) {
+        return minuteOfDay >= startMinute && minuteOfDay < endMinute;
+    }
+    return minuteOfDay >= startMinute || minuteOfDay < endMinute;
+}
+
+uint64_t BandwidthSchedule::RateAt(int minuteOfDay) const {
+    for (const BandwidthWindow& window : windows) {
+        if (window.Contains(minuteOfDay)) {
+            return window.bytesPerSecond;
+        }
+    }
+    return defaultBytesPerSecond;
+}
+
+bool BandwidthSchedule::HasLimits() const {
+    return defaultBytesPerSecond > 0 ||
+        std::any_of(windows.begin(), windows.end(), [](const BandwidthWindow& window) { return window.bytesPerSecond > 0; });
+}
+
+BandwidthLimiter& BandwidthLimiter::Instance() {
+    static BandwidthLimiter limiter;
+    return limiter;
+}
+
+bool BandwidthLimiter::LoadFromConfig(const std::string& configFilePath) {
+    try {
+        std::ifstream file(configFilePath);
+        if (!file.is_open()) {
+            LOG_WARN("Could not open '{}'; downloads are not throttled.", configFilePath);
+
+            SetSchedule({});
+            return true;
+        }
+
+        json config = json::parse(file);
+        if (!config.contains("BandwidthLimit")) {
+            SetSchedule({});
+            return true;
+        }
+
+        BandwidthSchedule schedule = ParseSchedule(config["BandwidthLimit"]);
+        SetSchedule(schedule);
+        LOG_INFO("Download bandwidth limit: {} kbit/s by default, {} time-of-day window(s).",
+            schedule.defaultBytesPerSecond * 8 / 1000, schedule.windows.size());
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Invalid 'BandwidthLimit' in '{}' ({}); downloads are not throttled.", configFilePath, e.what());
+
+        SetSchedule({});
+        return false;
+    }
+}
+
+void BandwidthLimiter::SetSchedule(const BandwidthSchedule& schedule) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_schedule = schedule;
+    m_tokens = 0;
+    m_rate = 0;
+    m_lastRefill = {};
+    m_rateCheckedAt = {};
+}
+
+bool BandwidthLimiter::HasLimits() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_schedule.HasLimits();
+}
+
+void BandwidthLimiter::Consume(size_t bytes) {
+    std::chrono::duration<double> wait(0);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Clock::time_point now = Clock::now();
+        const uint64_t rate = CurrentRate(now);
+        if (rate == 0) {
+            m_lastRefill = now;
+            return;
+        }
+
+        Refill(now, rate);
+        m_tokens -= static_cast<double>(bytes);
+        if (m_tokens < 0) {
+            wait = std::chrono::duration<double>(-m_tokens / static_cast<double>(rate));
+        }
+    }
+
+    if (wait.count() > 0) {
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+BandwidthLimiter::Clock::duration BandwidthLimiter::TryConsume(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Clock::time_point now = Clock::now();
+    const uint64_t rate = CurrentRate(now);
+    if (rate == 0) {
+        m_lastRefill = now;
+        return Clock::duration::zero();
+    }
+
+    Refill(now, rate);
+    if (m_tokens < 0) {
+        // Rounded up, so a wait is never reported as zero
+        return std::max(Clock::duration(1), std::chrono::ceil<Clock::duration>(
+            std::chrono::duration<double>(-m_tokens / static_cast<double>(rate))));
+    }
+    m_tokens -= static_cast<double>(bytes);
+    return Clock::duration::zero();
+}
+
+void BandwidthLimiter::Refill(Clock::time_point now, uint64_t rate) {
+    const double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+    m_lastRefill = now;
+    m_tokens = std::min(m_tokens + elapsed * static_cast<double>(rate), static_cast<double>(rate));
+}
+
+uint64_t BandwidthLimiter::CurrentRate(Clock::time_point now) {
+    if (m_rateCheckedAt != Clock::time_point{} && now - m_rateCheckedAt < std::chrono::seconds(1)) {
+        return m_rate;
+    }
+    m_rateCheckedAt = now;
+
+    const uint64_t rate = m_schedule.RateAt(LocalMinuteOfDay());
+    if (rate != m_rate) {
+        if (rate == 0) {
+            LOG_INFO("Download bandwidth is now unlimited.");
+        }
+        else {
+            LOG_INFO("Download bandwidth is now limited to {} kbit/s.", rate * 8 / 1000);
+        }
+        m_rate = rate;
+        m_tokens = std::min(m_tokens, static_cast<double>(rate));
+    }
+    return m_rate;
+}
@@ -0,0 +1,119 @@
+#ifndef BANDWIDTHLIMITER_H
+#define BANDWIDTHLIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Download rate that applies during part of the day, in local time.
+ *
+ * A window whose end is before its start wraps around midnight (e.g. 22:00-06:00); one whose
+ * start and end are equal covers the whole day.
+ */
+struct BandwidthWindow {
+    int startMinute = 0;          ///< First minute of the day the window applies to.
+    int endMinute = 0;            ///< Minute of the day the window ends at (exclusive).
+    uint64_t bytesPerSecond = 0;  ///< Rate limit during the window; 0 means unlimited.
+
+    [[nodiscard]] bool Contains(int minuteOfDay) const;
+};
+
+/**
+ * @brief Download rate limits by time of day.
+ */
+struct BandwidthSchedule {
+    uint64_t defaultBytesPerSecond = 0;  ///< Rate outside all windows; 0 means unlimited.
+    std::vector<BandwidthWindow> windows;
+
+    /// Returns the rate of the first window containing the minute, or the default rate.
+    [[nodiscard]] uint64_t RateAt(int minuteOfDay) const;
+
+    /// Returns true if the schedule limits the rate at any time of the day.
+    [[nodiscard]] bool HasLimits() const;
+};
+
+/**
+ * @class BandwidthLimiter
+ * @brief Process-wide token bucket that throttles package downloads.
+ *
+ * Every write callback of a download reports the bytes it received, and the transfer is held
+ * back until the bucket holds enough tokens again. Holding it back stops curl from reading
+ * the socket, so the TCP window closes and the server slows down to the configured rate.
+ * Transfers on the shared `TransferLoop` thread must not block it, so they are paused
+ * instead of sleeping (see `TryConsume()`); transfers on other threads block in `Consume()`.
+ * The bucket is shared by all transfers, so parallel segments and proxy downloads together
+ * stay within the limit.
+ *
+ * The rate follows a `BandwidthSchedule` loaded from the `BandwidthLimit` section of
+ * `serviceMainConfig.json`:
+ *
+ * @code
+ * "BandwidthLimit": {
+ *     "DefaultKbps": 0,
+ *     "Schedule": [ { "From": "07:00", "To": "22:00", "Kbps": 2000 } ]
+ * }
+ * @endcode
+ *
+ * Rates are in kilobits per second (1000 bits); 0 or a missing section means unlimited.
+ */
+class BandwidthLimiter {
+public:
+    static BandwidthLimiter& Instance();
+
+    /**
+     * @brief Loads the schedule from the `BandwidthLimit` section of a configuration file.
+     *
+     * A missing section clears the schedule. An invalid section is logged and also clears it,
+     * so a typo never blocks updates.
+     *
+     * @param configFilePath Path to `serviceMainConfig.json`.
+     * @return false if the section exists but could not be parsed.
+     */
+    bool LoadFromConfig(const std::string& configFilePath);
+
+    void SetSchedule(const BandwidthSchedule& schedule);
+
+    /// Returns true if downloads may be throttled at some time of the day.
+    [[nodiscard]] bool HasLimits() const;
+
+    /**
+     * @brief Takes `bytes` tokens from the bucket, sleeping until the current rate allows it.
+     */
+    void Consume(size_t bytes);
+
+    /**
+     * @brief Takes `bytes` tokens from the bucket unless it is in debt, without blocking.
+     *
+     * Like `Consume()`, a chunk may take the bucket into debt, so chunks larger than one
+     * second of data still get through; the next chunk then waits for the debt to be repaid.
+     *
+     * @return Zero if the tokens were taken, otherwise how long to wait before trying again.
+     */
+    std::chrono::steady_clock::duration TryConsume(size_t bytes);
+
+    BandwidthLimiter(const BandwidthLimiter&) = delete;
+    BandwidthLimiter& operator=(const BandwidthLimiter&) = delete;
+
+private:
+    BandwidthLimiter() = default;
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Returns the rate for the current local time, re-reading the clock at most once a second.
+    uint64_t CurrentRate(Clock::time_point now);
+
+    /// Adds the tokens for the time since the last refill; the bucket holds at most one second of data.
+    void Refill(Clock::time_point now, uint64_t rate);
+
+    mutable std::mutex m_mutex;
+    BandwidthSchedule m_schedule;
+    double m_tokens = 0;
+    uint64_t m_rate = 0;
+    Clock::time_point m_lastRefill{};
+    Clock::time_point m_rateCheckedAt{};
+};
+
+#endif // BANDWIDTHLIMITER_H
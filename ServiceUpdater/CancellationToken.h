@@ -0,0 +1,58 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+/**
+ * @class CancellationToken
+ * @brief Flag shared between an operation and the code that may cancel it.
+ *
+ * Copies of a token share one state, so a token handed to a download can be cancelled
+ * from any other thread. Cancellation is cooperative: the operation checks `IsCancelled()`
+ * at its next opportunity, and `SleepFor()` returns early once the token is cancelled.
+ * A cancelled token stays cancelled.
+ */
+class CancellationToken {
+public:
+    CancellationToken() : m_state(std::make_shared<State>()) {}
+
+    /**
+     * @brief Cancels the operation and wakes up every `SleepFor()` on the token.
+     */
+    void Cancel() const {
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->cancelled = true;
+        }
+        m_state->condition.notify_all();
+    }
+
+    [[nodiscard]] bool IsCancelled() const {
+        return m_state->cancelled.load();
+    }
+
+    /**
+     * @brief Sleeps for the given time unless the token is cancelled first.
+     * @return true if the full time elapsed, false if the token was cancelled.
+     */
+    template <typename Rep, typename Period>
+    bool SleepFor(const std::chrono::duration<Rep, Period>& duration) const {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        return !m_state->condition.wait_for(lock, duration, [this] { return m_state->cancelled.load(); });
+    }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{ false };
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
+#endif // CANCELLATIONTOKEN_H
@@ -0,0 +1,87 @@
+#include "CurlPool.h"
+#include "Logger.h"
+
+void CurlHandleRelease::operator()(CURL* curl) const {
+    if (curl) {
+        CurlPool::Instance().Release(curl);
+    }
+}
+
+CurlPool& CurlPool::Instance() {
+    static CurlPool pool;
+    return pool;
+}
+
+CurlPool::CurlPool() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    m_share = curl_share_init();
+    if (!m_share) {
+        LOG_WARN("Failed to create the shared curl cache; connections will not be reused across requests.");
+
+        return;
+    }
+
+    curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, LockShare);
+    curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, UnlockShare);
+    curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    if (curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT) != CURLSHE_OK) {
+        LOG_WARN("This libcurl cannot share connections; only DNS and TLS sessions are shared.");
+    }
+}
+
+CurlPool::~CurlPool() {
+    for (CURL* curl : m_idle) {
+        curl_easy_cleanup(curl);
+    }
+    m_idle.clear();
+
+    if (m_share) {
+        curl_share_cleanup(m_share);
+    }
+}
+
+CurlHandle CurlPool::Acquire() {
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        if (!m_idle.empty()) {
+            CURL* curl = m_idle.back();
+            m_idle.pop_back();
+            return CurlHandle(curl);
+        }
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        LOG_ERROR("Failed to initialize CURL");
+
+        return CurlHandle();
+    }
+
+    if (m_share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, m_share);
+    }
+    return CurlHandle(curl);
+}
+
+void CurlPool::Release(CURL* curl) {
+    // Resetting keeps the share, live connections and the session cache of the handle.
+    curl_easy_reset(curl);
+
+    std::lock_guard<std::mutex> lock(m_idleMutex);
+    if (m_idle.size() < kMaxIdleHandles) {
+        m_idle.push_back(curl);
+        return;
+    }
+    curl_easy_cleanup(curl);
+}
+
+void CurlPool::LockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<CurlPool*>(userptr)->m_shareLocks[data].lock();
+}
+
+void CurlPool::UnlockShare(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<CurlPool*>(userptr)->m_shareLocks[data].unlock();
+}
@@ -0,0 +1,66 @@
+#ifndef CURLPOOL_H
+#define CURLPOOL_H
+
+#include <curl/curl.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Returns an easy handle to the `CurlPool` instead of destroying it.
+ */
+struct CurlHandleRelease {
+    void operator()(CURL* curl) const;
+};
+
+/// Easy handle borrowed from the `CurlPool`.
+using CurlHandle = std::unique_ptr<CURL, CurlHandleRelease>;
+
+/**
+ * @class CurlPool
+ * @brief Process-wide pool of curl easy handles sharing one connection and TLS session cache.
+ *
+ * All handles are attached to a single `CURLSH` that shares the DNS cache, TLS session IDs
+ * and the connection cache. A HEAD probe, the download that follows it and any proxy
+ * request to the same host therefore reuse one warm connection instead of paying for a
+ * DNS lookup, TCP handshake and full TLS negotiation each. Released handles are reset and
+ * kept for reuse (up to `kMaxIdleHandles`), which also keeps their per-handle caches warm.
+ *
+ * Handles may be used from several threads at a time; the shared caches are protected by
+ * the lock callbacks of the share. The pool also performs `curl_global_init()` once.
+ */
+class CurlPool {
+public:
+    static CurlPool& Instance();
+
+    /**
+     * @brief Returns an easy handle with default options and the shared caches attached.
+     * @return The handle, or an empty handle if curl could not allocate one.
+     */
+    CurlHandle Acquire();
+
+    /**
+     * @brief Resets a handle and keeps it for reuse, or destroys it if the pool is full.
+     */
+    void Release(CURL* curl);
+
+    CurlPool(const CurlPool&) = delete;
+    CurlPool& operator=(const CurlPool&) = delete;
+
+private:
+    CurlPool();
+    ~CurlPool();
+
+    /// Number of idle handles kept for reuse.
+    static constexpr size_t kMaxIdleHandles = 8;
+
+    CURLSH* m_share = nullptr;
+    std::mutex m_shareLocks[CURL_LOCK_DATA_LAST];
+    std::mutex m_idleMutex;
+    std::vector<CURL*> m_idle;
+
+    static void LockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void UnlockShare(CURL* handle, curl_lock_data data, void* userptr);
+};
+
+#endif // CURLPOOL_H
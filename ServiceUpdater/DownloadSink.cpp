@@ -0,0 +1,203 @@
+#include "DownloadSink.h"
+#include <algorithm>
+#include <cstring>
+#include "Logger.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DownloadSink::~DownloadSink() {
+    Close();
+}
+
+bool DownloadSink::Open(const fs::path& path, uint64_t offset, bool truncate) {
+    Close();
+    m_path = path;
+    m_position = offset;
+    m_buffered = 0;
+    m_failed = false;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Failed to open file: {} (error {})", path.string(), GetLastError());
+
+        return false;
+    }
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFilePointerEx(handle, position, nullptr, FILE_BEGIN)) {
+        LOG_ERROR("Failed to seek to byte {} of {} (error {})", offset, path.string(), GetLastError());
+
+        CloseHandle(handle);
+        return false;
+    }
+    m_handle = handle;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open file: {} (errno {})", path.string(), errno);
+
+        return false;
+    }
+    if (::lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        LOG_ERROR("Failed to seek to byte {} of {} (errno {})", offset, path.string(), errno);
+
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+#endif
+
+    if (!m_buffer) {
+        m_buffer.reset(static_cast<unsigned char*>(::operator new(kBufferSize, std::align_val_t{ 4096 })));
+    }
+    return true;
+}
+
+bool DownloadSink::Reserve(uint64_t totalSize) {
+    if (!IsOpen()) {
+        return false;
+    }
+
+    const uint64_t remaining = totalSize > m_position ? totalSize - m_position : 0;
+    switch (CheckFreeSpace(m_path, remaining)) {
+    case FreeSpace::NotEnough:
+        LOG_ERROR("Not enough free disk space for {}: {} more bytes are needed.", m_path.string(), remaining);
+
+        return false;
+    case FreeSpace::Unknown:
+        LOG_WARN("Free disk space for {} is unknown; downloading {} more bytes without the check.", m_path.string(), remaining);
+        break;
+    case FreeSpace::Enough:
+        break;
+    }
+
+#ifdef _WIN32
+    FILE_ALLOCATION_INFO allocation;
+    allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(totalSize);
+    if (!SetFileInformationByHandle(static_cast<HANDLE>(m_handle), FileAllocationInfo, &allocation, sizeof(allocation))) {
+        LOG_WARN("Failed to preallocate {} bytes for {} (error {})", totalSize, m_path.string(), GetLastError());
+    }
+#elif defined(__linux__)
+    if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(totalSize)) != 0 && errno != EOPNOTSUPP) {
+        LOG_WARN("Failed to preallocate {} bytes for {} (errno {})", totalSize, m_path.string(), errno);
+    }
+#endif
+    return true;
+}
+
+bool DownloadSink::Write(const void* data, size_t size) {
+    if (!IsOpen() || m_failed) {
+        return false;
+    }
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while (size > 0) {
+        // Fill the buffer up to the next boundary, so every write after the first one is aligned.
+        const size_t limit = kBufferSize - static_cast<size_t>(m_position % kBufferSize);
+        const size_t count = std::min(size, limit - m_buffered);
+        std::memcpy(m_buffer.get() + m_buffered, bytes, count);
+        m_buffered += count;
+        bytes += count;
+        size -= count;
+
+        if (m_buffered == limit && !Flush()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DownloadSink::Flush() {
+    if (!IsOpen() || m_failed) {
+        return false;
+    }
+    if (m_buffered == 0) {
+        return true;
+    }
+
+    if (!WriteOut(m_buffer.get(), m_buffered)) {
+        m_failed = true;
+        return false;
+    }
+    m_position += m_buffered;
+    m_buffered = 0;
+    return true;
+}
+
+bool DownloadSink::Close(bool sync) {
+    if (!IsOpen()) {
+        return !m_failed;
+    }
+
+    bool ok = Flush();
+#ifdef _WIN32
+    if (ok && sync && !FlushFileBuffers(static_cast<HANDLE>(m_handle))) {
+        LOG_ERROR("Failed to flush {} to disk (error {})", m_path.string(), GetLastError());
+        ok = false;
+    }
+    CloseHandle(static_cast<HANDLE>(m_handle));
+    m_handle = nullptr;
+#else
+    if (ok && sync && ::fsync(m_fd) != 0) {
+        LOG_ERROR("Failed to flush {} to disk (errno {})", m_path.string(), errno);
+        ok = false;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+#endif
+    return ok;
+}
+
+bool DownloadSink::IsOpen() const {
+#ifdef _WIN32
+    return m_handle != nullptr;
+#else
+    return m_fd >= 0;
+#endif
+}
+
+DownloadSink::FreeSpace DownloadSink::CheckFreeSpace(const fs::path& path, uint64_t bytes) {
+    try {
+        fs::path volume = path.has_parent_path() ? path.parent_path() : fs::current_path();
+        return fs::space(volume).available >= bytes ? FreeSpace::Enough : FreeSpace::NotEnough;
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Failed to check disk space for {}: {}", path.string(), e.what());
+
+        return FreeSpace::Unknown;
+    }
+}
+
+bool DownloadSink::WriteOut(const unsigned char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(static_cast<HANDLE>(m_handle), data, chunk, &written, nullptr) || written == 0) {
+            LOG_ERROR("Failed to write to {} (error {})", m_path.string(), GetLastError());
+
+            return false;
+        }
+#else
+        ssize_t written = ::write(m_fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            LOG_ERROR("Failed to write to {} (errno {})", m_path.string(), errno);
+
+            return false;
+        }
+#endif
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
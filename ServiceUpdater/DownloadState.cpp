@@ -0,0 +1,138 @@
+#include "DownloadState.h"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include "Logger.h"
+
+using json = nlohmann::json;
+
+namespace {
+    /**
+     * @brief Writes a JSON document to a temporary file and renames it over `path`.
+     */
+    bool WriteJsonAtomically(const fs::path& path, const json& data) {
+        fs::path tempPath = path;
+        tempPath += ".tmp";
+
+        try {
+            {
+                std::ofstream file(tempPath, std::ios::trunc);
+                if (!file.is_open()) {
+                    LOG_ERROR("Failed to open file for writing: {}", tempPath.string());
+
+                    return false;
+                }
+                file << data.dump(4);
+                if (!file.flush()) {
+                    LOG_ERROR("Failed to write file: {}", tempPath.string());
+
+                    return false;
+                }
+            }
+
+            fs::rename(tempPath, path);
+            return true;
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Failed to save '{}': {}", path.string(), e.what());
+
+            return false;
+        }
+    }
+
+    std::optional<json> ReadJson(const fs::path& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+
+        try {
+            return json::parse(file);
+        }
+        catch (const std::exception& e) {
+            LOG_WARN("Ignoring unreadable file '{}': {}", path.string(), e.what());
+
+            return std::nullopt;
+        }
+    }
+}
+
+std::string UrlWithoutQuery(const std::string& url) {
+    return url.substr(0, url.find_first_of("?#"));
+}
+
+fs::path PartialDownloadState::PartialPath(const fs::path& destination) {
+    fs::path path = destination;
+    path += ".part";
+    return path;
+}
+
+fs::path PartialDownloadState::StatePath(const fs::path& destination) {
+    fs::path path = destination;
+    path += ".part.json";
+    return path;
+}
+
+std::optional<PartialDownloadState> PartialDownloadState::Load(const fs::path& destination) {
+    auto data = ReadJson(StatePath(destination));
+    if (!data || !data->is_object()) {
+        return std::nullopt;
+    }
+
+    PartialDownloadState state;
+    state.url = data->value("url", "");
+    state.validators.etag = data->value("etag", "");
+    state.validators.lastModified = data->value("last_modified", "");
+    state.totalSize = data->value("total_size", uint64_t{ 0 });
+    return state;
+}
+
+bool PartialDownloadState::Save(const fs::path& destination) const {
+    return WriteJsonAtomically(StatePath(destination), {
+        {"url", url},
+        {"etag", validators.etag},
+        {"last_modified", validators.lastModified},
+        {"total_size", totalSize}
+        });
+}
+
+void PartialDownloadState::Discard(const fs::path& destination) {
+    std::error_code ec;
+    fs::remove(PartialPath(destination), ec);
+    fs::remove(StatePath(destination), ec);
+}
+
+fs::path PackageFetchRecord::RecordPath(const fs::path& destination) {
+    fs::path path = destination;
+    path += ".fetch.json";
+    return path;
+}
+
+std::optional<PackageFetchRecord> PackageFetchRecord::Load(const fs::path& destination) {
+    auto data = ReadJson(RecordPath(destination));
+    if (!data || !data->is_object()) {
+        return std::nullopt;
+    }
+
+    PackageFetchRecord record;
+    record.url = data->value("url", "");
+    record.validators.etag = data->value("etag", "");
+    record.validators.lastModified = data->value("last_modified", "");
+    record.content.md5 = data->value("content_md5", "");
+    record.content.length = data->value("content_length", uint64_t{ 0 });
+    return record;
+}
+
+bool PackageFetchRecord::Save(const fs::path& destination) const {
+    return WriteJsonAtomically(RecordPath(destination), {
+        {"url", url},
+        {"etag", validators.etag},
+        {"last_modified", validators.lastModified},
+        {"content_md5", content.md5},
+        {"content_length", content.length}
+        });
+}
+
+void PackageFetchRecord::Remove(const fs::path& destination) {
+    std::error_code ec;
+    fs::remove(RecordPath(destination), ec);
+}
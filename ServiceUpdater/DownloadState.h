@@ -0,0 +1,88 @@
+#ifndef DOWNLOADSTATE_H
+#define DOWNLOADSTATE_H
+
+#include <string>
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include "HttpHeaders.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Returns a URL without its query string.
+ *
+ * Download records identify a resource by this form, so that the SAS token carried in the
+ * query string is never written to disk.
+ */
+std::string UrlWithoutQuery(const std::string& url);
+
+/**
+ * @brief Persisted progress of an interrupted download.
+ *
+ * A download is written to `<destination>.part` and only renamed to its destination once
+ * complete. This record lives next to the partial file, in `<destination>.part.json`, and
+ * holds what is needed to continue it with a range request, also after a service restart:
+ * the source URL and the validators of the response the partial content came from. The
+ * number of bytes already received is the size of the partial file itself.
+ */
+struct PartialDownloadState {
+    std::string url;            ///< URL the partial content was downloaded from, see `UrlWithoutQuery()`.
+    HttpValidators validators;  ///< Validators of that response, sent back in `If-Range`.
+    uint64_t totalSize = 0;     ///< Size of the complete resource, or 0 if unknown.
+
+    /// Path of the partial file of a download.
+    static fs::path PartialPath(const fs::path& destination);
+    /// Path of the state record of a download.
+    static fs::path StatePath(const fs::path& destination);
+
+    /**
+     * @brief Loads the state record of a download.
+     * @return The state, or `std::nullopt` if there is none or it cannot be parsed.
+     */
+    static std::optional<PartialDownloadState> Load(const fs::path& destination);
+
+    /**
+     * @brief Writes the state record of a download, replacing the previous one atomically.
+     */
+    bool Save(const fs::path& destination) const;
+
+    /**
+     * @brief Removes the partial file and the state record of a download.
+     */
+    static void Discard(const fs::path& destination);
+};
+
+/**
+ * @brief Record of the package that was last downloaded and processed.
+ *
+ * Kept next to the download as `<destination>.fetch.json` and written only once a package
+ * has been fully handled (applied, or found to be unchanged), so that the next update cycle
+ * can ask the server for the package only if it differs from this one.
+ */
+struct PackageFetchRecord {
+    std::string url;            ///< URL the package was downloaded from, see `UrlWithoutQuery()`.
+    HttpValidators validators;  ///< Validators of the response it came from.
+    ContentFingerprint content; ///< MD5 and length of the package, if the server reported them.
+
+    /// Path of the record of a download destination.
+    static fs::path RecordPath(const fs::path& destination);
+
+    /**
+     * @brief Loads the record of a download destination.
+     * @return The record, or `std::nullopt` if there is none or it cannot be parsed.
+     */
+    static std::optional<PackageFetchRecord> Load(const fs::path& destination);
+
+    /**
+     * @brief Writes the record of a download destination, replacing the previous one atomically.
+     */
+    bool Save(const fs::path& destination) const;
+
+    /**
+     * @brief Removes the record of a download destination.
+     */
+    static void Remove(const fs::path& destination);
+};
+
+#endif // DOWNLOADSTATE_H
@@ -10,28 +10,68 @@
 #include <spdlog/spdlog.h>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <curl/curl.h>
 #include "Proxy.h"
+#include "HttpHeaders.h"
+#include "DownloadState.h"
+#include "CurlPool.h"
+#include "RetryPolicy.h"
+#include "BandwidthLimiter.h"
+#include "DownloadSink.h"
+#include "CancellationToken.h"
+#include "TransferLoop.h"
+#include "HashEngine.h"
 
 namespace fs = std::filesystem;
 
 class FileDownloader {
 public:
+    /**
+     * @brief Receives the progress of a download: bytes of the file received so far and its
+     *        total size (0 while unknown). Called on the transfer thread, and only once
+     *        body data has arrived.
+     */
+    using ProgressCallback = std::function<void(uint64_t received, uint64_t total)>;
+
+    /**
+     * @brief Result and cancellation handle of a download started with `downloadAsync()`.
+     */
+    struct DownloadHandle {
+        std::future<bool> result;
+        CancellationToken cancellation;
+
+        /// Asks the download to stop; `result` then becomes false, keeping the partial file.
+        void Cancel() const {
+            cancellation.Cancel();
+        }
+    };
+
     FileDownloader(const std::string& url, const std::string& destinationPath, int maxRetries = 3, int timeoutSeconds = 60)
-        : url(url), destinationPath(destinationPath), maxRetries(maxRetries), timeoutSeconds(timeoutSeconds) {
+        : url(url), destinationPath(destinationPath), retryPolicy(maxRetries), timeoutSeconds(timeoutSeconds) {
     }
 
     /**
-     * @brief Callback function for writing data to a file during download.
+     * @brief Callback function for writing data to the partial file during download.
      *
-     * This function is used by `libcurl` to write received data into a file. It checks for valid
-     * pointers before proceeding with writing data. If an error occurs, it logs the issue and
-     * returns 0 to indicate failure.
+     * This function is used by `libcurl` to append received data to the partial file of a
+     * transfer. Before the first chunk of a resumed transfer is written, it checks whether the
+     * server honored the range request; if it sent the whole resource instead (because the
+     * `If-Range` validator no longer matched), the partial file is truncated first. Once the
+     * first chunk arrives the download state is persisted, so the transfer can be resumed
+     * even if the process is stopped. Every chunk written is added to the SHA-256 digest of
+     * the transfer. Received data counts against the shared `BandwidthLimiter`, which may
+     * pause the transfer to keep the configured download rate (see
+     * `TransferLoop::PauseForBandwidth()`).
+     * If an error occurs, it logs the issue and returns 0 to indicate failure.
      *
      * @param contents Pointer to the downloaded data.
      * @param size Size of a single data unit.
      * @param nmemb Number of data units.
-     * @param userp Pointer to the file stream where data should be written.
+     * @param userp Pointer to the `Transfer` being written.
      * @return The number of bytes written to the file, or 0 on failure.
      */
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
@@ -40,42 +80,148 @@ public:
             return 0;
         }
 
-        std::ofstream* file = static_cast<std::ofstream*>(userp);
-        if (!file->is_open()) {
+        Transfer* transfer = static_cast<Transfer*>(userp);
+        if (TransferLoop::Instance().PauseForBandwidth(transfer->curl, size * nmemb)) {
+            return CURL_WRITEFUNC_PAUSE;
+        }
+        if (transfer->received == 0 && !transfer->BeginBody()) {
+            return 0;
+        }
+
+        if (!transfer->file.IsOpen()) {
             LOG_ERROR("WriteCallback: File is not open for writing.");
             return 0;
         }
-        file->write(static_cast<const char*>(contents), size * nmemb);
+        if (!transfer->file.Write(contents, size * nmemb)) {
+            LOG_ERROR("WriteCallback: Failed to write to {}", transfer->partialPath.string());
+            return 0;
+        }
+        transfer->digest.Update(contents, size * nmemb);
+        if (transfer->md5) {
+            transfer->md5->Update(contents, size * nmemb);
+        }
+        transfer->received += size * nmemb;
         return size * nmemb;
     }
 
     /**
-     * @brief Checks if there is enough free disk space before downloading a file.
+     * @brief Sets the number of byte ranges a download is fetched in concurrently.
      *
-     * This function determines whether the available disk space is sufficient for the file
-     * to be downloaded. It logs an error if the disk space check fails.
+     * With more than one segment, `download()` splits files of at least `kMinSegmentSize`
+     * bytes per segment into ranges that are fetched in parallel on the `TransferLoop`.
+     * Servers that do not advertise `Accept-Ranges: bytes` are downloaded in a single stream.
      *
-     * @param fileSize The size of the file to be downloaded.
-     * @return true if there is enough free space, false otherwise.
+     * @param segments Number of concurrent ranges; 1 disables segmented downloads.
      */
-    bool hasSufficientDiskSpace(uint64_t fileSize) {
-        try {
-            auto spaceInfo = fs::space(fs::path(destinationPath).parent_path());
-            return spaceInfo.available >= fileSize;
-        }
-        catch (const std::exception& e) {
-            LOG_ERROR("Failed to check disk space: {}", e.what());
-            return false;
-        }
+    void setParallelSegments(int segments) {
+        parallelSegments = std::max(1, segments);
+    }
+
+    /**
+     * @brief Sets the callback that receives the progress of `download()` and `downloadToMemory()`.
+     */
+    void setProgressCallback(ProgressCallback callback) {
+        progressCallback = std::move(callback);
+    }
+
+    /**
+     * @brief Sets the token that cancels the downloads of this downloader.
+     *
+     * A cancelled download aborts its transfer and any wait before a retry, and returns
+     * false. The partial file of a single-stream download is kept, so the download resumes
+     * where it stopped the next time. Downloads are also cancelled by `TransferLoop::AbortAll()`.
+     */
+    void setCancellationToken(const CancellationToken& token) {
+        cancellation = token;
+    }
+
+    /**
+     * @brief Replaces the retry policy built from the `maxRetries` constructor argument.
+     *
+     * @param policy Attempts, backoff delays and time budget for retrying failed transfers.
+     */
+    void setRetryPolicy(const RetryPolicy& policy) {
+        retryPolicy = policy;
+    }
+
+    /**
+     * @brief Makes the next download conditional on the resource having changed.
+     *
+     * The validators of a previously downloaded copy are sent as `If-None-Match` and
+     * `If-Modified-Since`. If the server answers 304, `download()` succeeds without writing
+     * anything and `wasNotModified()` returns true. Resumed transfers are not conditional.
+     *
+     * @param validators Validators from `getResponseValidators()` of the earlier download.
+     */
+    void setConditionalValidators(const HttpValidators& validators) {
+        conditionalValidators = validators;
+    }
+
+    /**
+     * @brief Makes downloads succeed only if the body has the given MD5 and length.
+     *
+     * Meant for copies of a package served by a source that is not trusted on its own, such
+     * as a site cache on the LAN, checked against the fingerprint the origin reported. The
+     * MD5 is computed while the body is received. A body that does not match is discarded
+     * and the download fails without retrying. Verified downloads use a single stream.
+     * Downloads through a proxy are not verified.
+     *
+     * @param fingerprint Base64 MD5 and length of the expected content; empty to not verify.
+     */
+    void setExpectedContent(const ContentFingerprint& fingerprint) {
+        expectedContent = fingerprint;
+    }
+
+    /**
+     * @brief Returns true if the last download was skipped because the resource is unchanged.
+     */
+    bool wasNotModified() const {
+        return notModified;
+    }
+
+    /**
+     * @brief Returns the `ETag` / `Last-Modified` of the last downloaded (or unchanged) resource.
+     */
+    const HttpValidators& getResponseValidators() const {
+        return responseValidators;
+    }
+
+    /**
+     * @brief Returns the MD5 and length the server reported for the last downloaded file, if any.
+     */
+    const ContentFingerprint& getResponseFingerprint() const {
+        return responseFingerprint;
+    }
+
+    /**
+     * @brief Returns the SHA-256 hash of the last downloaded file, computed during the transfer.
+     *
+     * Empty if nothing was downloaded, or if the digest could not be computed along the way
+     * (for example when a complete partial file was found on disk); the caller then has
+     * to hash the file itself.
+     */
+    const std::optional<std::string>& getContentSha256() const {
+        return contentSha256;
     }
 
     /**
      * @brief Securely downloads a file using `libcurl` with a retry mechanism.
      *
      * This function downloads a file from a specified URL using `libcurl`. It ensures the
-     * destination directory exists, handles errors gracefully, and retries downloading if a
-     * recoverable server error occurs (5xx HTTP responses). The function also verifies the
-     * response code and logs necessary information throughout the process.
+     * destination directory exists, handles errors gracefully, and retries downloading after
+     * transient failures (network errors, timeouts, 408, 429 and 5xx responses) as decided by
+     * the retry policy (see `setRetryPolicy()`), waiting an exponentially growing, jittered
+     * delay or the `Retry-After` of the server between attempts. The function also verifies
+     * the response code and logs necessary information throughout the process.
+     *
+     * Data is written to `<destination>.part`, which is renamed to the destination once the
+     * transfer is complete. If a previous attempt (or a previous run of the service) left a
+     * partial file from the same URL, the transfer continues where it stopped with a `Range`
+     * request. The request carries the validator of the earlier response in `If-Range`, so a
+     * resource that changed in the meantime is downloaded again from the start.
+     *
+     * If parallel segments are enabled (see `setParallelSegments()`) and there is no partial
+     * file to resume, the file is first tried as a segmented download.
      *
      * @return true if the download is successful, false otherwise.
      */
@@ -94,72 +240,285 @@ public:
                 }
             }
 
-            int attempt = 0;
-            while (attempt < maxRetries) {
-                if (attempt > 0) {
-                    LOG_WARN("Retrying download... Attempt: {}", attempt + 1);
-
-                    std::this_thread::sleep_for(std::chrono::seconds(5));
+            const fs::path destination(destinationPath);
+            notModified = false;
+            responseValidators = {};
+            responseFingerprint = {};
+            contentSha256.reset();
+            if (parallelSegments > 1 && expectedContent.Empty() && !HasResumablePartial(destination)) {
+                SegmentedResult segmented = DownloadSegmented(destination);
+                if (segmented != SegmentedResult::Unsupported) {
+                    return segmented != SegmentedResult::Failed;
                 }
+            }
 
-                std::ofstream outputFile(destinationPath, std::ios::binary | std::ios::trunc);
-                if (!outputFile.is_open()) {
-                    LOG_ERROR("Failed to open file: {}", destinationPath);
-
-                    return false;
+            const auto started = RetryPolicy::Clock::now();
+            int failures = 0;
+            while (true) {
+                Transfer transfer(url, destination);
+                transfer.owner = this;
+                transfer.resumeOffset = ResumableOffset(destination, transfer.state);
+                if (!expectedContent.Empty()) {
+                    transfer.md5 = std::make_unique<DigestStream>(EVP_md5());
                 }
+                if (transfer.resumeOffset > 0 && transfer.resumeOffset == transfer.state.totalSize) {
+                    LOG_INFO("Partial download of {} is already complete.", destinationPath);
 
-                struct CurlDeleter {
-                    void operator()(CURL* curl) const {
-                        if (curl) {
-                            curl_easy_cleanup(curl);
-                        }
+                    if (transfer.md5 && !transfer.md5->UpdateFromFile(transfer.partialPath, 0, transfer.resumeOffset)) {
+                        return false;
                     }
-                };
+                    if (!VerifyExpectedContent(transfer.md5.get(), transfer.resumeOffset)) {
+                        PartialDownloadState::Discard(destination);
+                        return false;
+                    }
+                    responseValidators = transfer.state.validators;
+                    return Finalize(destination);
+                }
 
-                std::unique_ptr<CURL, CurlDeleter> curl(curl_easy_init());
+                CurlHandle curl = CurlPool::Instance().Acquire();
                 if (!curl) {
-                    LOG_ERROR("Failed to initialize CURL");
-
                     return false;
                 }
 
+                std::unique_ptr<curl_slist, SlistDeleter> headers;
+                std::string range;
+                if (transfer.resumeOffset == 0) {
+                    headers.reset(AppendConditionalHeaders(nullptr));
+                    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
+                }
+                else {
+                    LOG_INFO("Resuming download of {} at byte {}.", destinationPath, transfer.resumeOffset);
+
+                    range = std::to_string(transfer.resumeOffset) + "-";
+                    headers.reset(curl_slist_append(nullptr, ("If-Range: " + transfer.state.validators.IfRangeValue()).c_str()));
+                    curl_easy_setopt(curl.get(), CURLOPT_RANGE, range.c_str());
+                    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
+                }
+
                 curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+                transfer.curl = curl.get();
                 curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, WriteCallback);
-                curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &outputFile);
+                curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &transfer);
+                curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, HttpResponseHeaders::HeaderCallback);
+                curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &transfer.headers);
+                curl_easy_setopt(curl.get(), CURLOPT_XFERINFOFUNCTION, TransferProgressCallback<Transfer>);
+                curl_easy_setopt(curl.get(), CURLOPT_XFERINFODATA, &transfer);
+                curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
                 curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
                 curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, 0L);
                 curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, 0L);
-                curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, timeoutSeconds);
+                ApplyTransferTimeout(curl.get());
                 curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
 
-                CURLcode res = curl_easy_perform(curl.get());
+                CURLcode res = TransferLoop::Instance().Perform(curl.get(), cancellation).get();
                 long response_code = 0;
                 curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
-                outputFile.close();
+                // A complete body is flushed to disk here, before it is renamed into place
+                if (!transfer.file.Close(res == CURLE_OK) && res == CURLE_OK) {
+                    return false;
+                }
+                if (res == CURLE_ABORTED_BY_CALLBACK && IsCancelled()) {
+                    LOG_WARN("Download of {} was cancelled after {} bytes.", destinationPath, transfer.received);
 
-                if (res == CURLE_OK && response_code == 200) {
-                    LOG_INFO("Download successful: {}", destinationPath);
+                    return false;
+                }
 
+                if (res == CURLE_OK && response_code == 304) {
+                    LOG_INFO("{} is unchanged on the server (304); nothing was downloaded.", url);
+
+                    notModified = true;
+                    responseValidators = transfer.headers.Validators();
                     return true;
                 }
+
+                std::optional<std::chrono::milliseconds> retryAfter;
+                if (res == CURLE_OK && (response_code == 200 || response_code == 206)) {
+                    if (transfer.received == 0) {
+                        if (!transfer.BeginBody() || !transfer.file.Close(true)) {
+                            return false;
+                        }
+                    }
+                    if (transfer.state.totalSize == 0 || fs::file_size(transfer.partialPath) == transfer.state.totalSize) {
+                        if (!VerifyExpectedContent(transfer.md5.get(), fs::file_size(transfer.partialPath))) {
+                            PartialDownloadState::Discard(destination);
+                            return false;
+                        }
+                        responseValidators = transfer.state.validators;
+                        responseFingerprint = transfer.headers.Fingerprint();
+                        contentSha256 = transfer.digest.Finish();
+                        return Finalize(destination);
+                    }
+
+                    LOG_WARN("Download of {} ended at {} of {} bytes.", destinationPath,
+                        fs::file_size(transfer.partialPath), transfer.state.totalSize);
+                }
+                else if (response_code == 416) {
+                    LOG_WARN("Server rejected the resume range for {}; restarting the download.", destinationPath);
+
+                    PartialDownloadState::Discard(destination);
+                }
                 else {
                     HandleCurlError(res, response_code);
-                    if (response_code >= 500 && response_code < 600) {
-                        attempt++;
-                        continue;  // Retry for server errors (5xx)
+                    if (!RetryPolicy::IsRetryable(res, response_code)) {
+                        return false;  // Permanent errors, no retry
+                    }
+                    if (transfer.received > 0) {
+                        LOG_WARN("Transfer interrupted after {} bytes; the partial file is kept.", transfer.received);
+
                     }
-                    return false;  // Other errors, no retry
+                    retryAfter = RetryPolicy::RetryAfter(transfer.headers);
                 }
-            }
 
-            LOG_ERROR("Download failed after {} attempts", maxRetries);
+                auto delay = retryPolicy.NextDelay(++failures, started, retryAfter);
+                if (!delay) {
+                    LOG_ERROR("Download failed after {} attempts", failures);
+
+                    return false;
+                }
+                LOG_WARN("Retrying download in {:.1f} s... Attempt: {}", delay->count() / 1000.0, failures + 1);
+
+                if (!WaitBeforeRetry(*delay)) {
+                    return false;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Exception during download: {}", e.what());
 
             return false;
         }
+    }
+
+    /**
+     * @brief Starts `download()` in the background.
+     *
+     * The transfers themselves run on the shared `TransferLoop` thread. The downloader must
+     * outlive the returned handle, whose future blocks on destruction until the download ends.
+     *
+     * @return Handle to wait for the result or cancel the download.
+     */
+    DownloadHandle downloadAsync() {
+        DownloadHandle handle;
+        handle.cancellation = cancellation;
+        handle.result = std::async(std::launch::async, [this] { return download(); });
+        return handle;
+    }
+
+    /**
+     * @brief Downloads the URL into a memory buffer instead of the destination file.
+     *
+     * Meant for small packages that are extracted right away, which saves writing the package
+     * to disk, reading it back and deleting it. The transfer is a single stream without
+     * resume; conditional validators, the retry policy and bandwidth limiting apply as for
+     * `download()`. Nothing is written to disk, not even on failure.
+     *
+     * @param buffer Receives the response body; cleared first.
+     * @param maxSize Largest body accepted; a larger response fails the download.
+     * @return true if the body was downloaded or the server answered 304, false otherwise.
+     */
+    bool downloadToMemory(std::string& buffer, uint64_t maxSize) {
+        std::lock_guard<std::mutex> lock(downloadMutex);
+
+        try {
+            notModified = false;
+            responseValidators = {};
+            responseFingerprint = {};
+            contentSha256.reset();
+
+            const auto started = RetryPolicy::Clock::now();
+            int failures = 0;
+            while (true) {
+                buffer.clear();
+                MemoryTransfer transfer{ this, &buffer, maxSize };
+                if (!expectedContent.Empty()) {
+                    transfer.md5 = std::make_unique<DigestStream>(EVP_md5());
+                }
+
+                CurlHandle curl = CurlPool::Instance().Acquire();
+                if (!curl) {
+                    return false;
+                }
+
+                std::unique_ptr<curl_slist, SlistDeleter> headers(AppendConditionalHeaders(nullptr));
+                curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+                curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
+                transfer.curl = curl.get();
+                curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, MemoryWriteCallback);
+                curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &transfer);
+                curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, HttpResponseHeaders::HeaderCallback);
+                curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &transfer.headers);
+                curl_easy_setopt(curl.get(), CURLOPT_XFERINFOFUNCTION, TransferProgressCallback<MemoryTransfer>);
+                curl_easy_setopt(curl.get(), CURLOPT_XFERINFODATA, &transfer);
+                curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
+                curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
+                curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, 0L);
+                curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, 0L);
+                ApplyTransferTimeout(curl.get());
+                curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+
+                CURLcode res = TransferLoop::Instance().Perform(curl.get(), cancellation).get();
+                long response_code = 0;
+                curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+                if (res == CURLE_ABORTED_BY_CALLBACK && IsCancelled()) {
+                    LOG_WARN("Download of {} was cancelled.", url);
+
+                    buffer.clear();
+                    return false;
+                }
+
+                if (res == CURLE_OK && response_code == 304) {
+                    LOG_INFO("{} is unchanged on the server (304); nothing was downloaded.", url);
+
+                    notModified = true;
+                    responseValidators = transfer.headers.Validators();
+                    return true;
+                }
+
+                if (res == CURLE_OK && response_code == 200) {
+                    if (!VerifyExpectedContent(transfer.md5.get(), buffer.size())) {
+                        buffer.clear();
+                        return false;
+                    }
+                    LOG_INFO("Downloaded {} bytes into memory.", buffer.size());
+
+                    responseValidators = transfer.headers.Validators();
+                    responseFingerprint = transfer.headers.Fingerprint();
+                    contentSha256 = transfer.digest.Finish();
+                    return true;
+                }
+
+                if (transfer.tooLarge) {
+                    LOG_ERROR("{} is larger than the {} bytes allowed for an in-memory download.", url, maxSize);
+
+                    buffer.clear();
+                    return false;
+                }
+
+                HandleCurlError(res, response_code);
+                if (!RetryPolicy::IsRetryable(res, response_code)) {
+                    buffer.clear();
+                    return false;
+                }
+
+                auto delay = retryPolicy.NextDelay(++failures, started, RetryPolicy::RetryAfter(transfer.headers));
+                if (!delay) {
+                    LOG_ERROR("Download failed after {} attempts", failures);
+
+                    buffer.clear();
+                    return false;
+                }
+                LOG_WARN("Retrying download in {:.1f} s... Attempt: {}", delay->count() / 1000.0, failures + 1);
+
+                if (!WaitBeforeRetry(*delay)) {
+                    buffer.clear();
+                    return false;
+                }
+            }
+        }
         catch (const std::exception& e) {
             LOG_ERROR("Exception during download: {}", e.what());
 
+            buffer.clear();
             return false;
         }
     }
@@ -192,7 +551,9 @@ public:
 
                 }
                 else {
-                    return proxy.proxyDownload(url, destinationPath);
+                    bool downloaded = proxy.proxyDownload(url, destinationPath);
+                    contentSha256 = proxy.getDownloadedSha256();
+                    return downloaded;
                 }
             }
             else {
@@ -200,8 +561,19 @@ public:
 
             }
 
-            FileDownloader downloader(url, destinationPath);
-            return downloader.download();
+            FileDownloader downloader(url, destinationPath, retryPolicy.MaxAttempts(), timeoutSeconds);
+            downloader.setRetryPolicy(retryPolicy);
+            downloader.setParallelSegments(parallelSegments);
+            downloader.setConditionalValidators(conditionalValidators);
+            downloader.setProgressCallback(progressCallback);
+            downloader.setCancellationToken(cancellation);
+            downloader.setExpectedContent(expectedContent);
+            bool downloaded = downloader.download();
+            notModified = downloader.notModified;
+            responseValidators = downloader.responseValidators;
+            responseFingerprint = downloader.responseFingerprint;
+            contentSha256 = downloader.contentSha256;
+            return downloaded;
         }
         catch (const std::exception& e) {
             LOG_ERROR("Exception occurred in downloadWithOptionalProxy: {}", e.what());
@@ -231,12 +603,13 @@ private:
     std::string destinationPath;
 
     /**
-     * @brief Maximum number of retry attempts for the download.
+     * @brief Decides which failures are retried and how long to wait between attempts.
      *
-     * If the download fails due to a recoverable error (e.g., server-side errors),
-     * the function will retry up to this specified number of times.
+     * If the download fails due to a transient error (e.g., network or server-side errors),
+     * it is retried with exponential backoff until the attempts or the time budget of the
+     * policy are used up.
      */
-    int maxRetries;
+    RetryPolicy retryPolicy;
 
     /**
      * @brief Timeout duration (in seconds) for the download operation.
@@ -254,6 +627,740 @@ private:
      */
     std::mutex downloadMutex;
 
+    /**
+     * @brief Number of byte ranges fetched concurrently; 1 downloads in a single stream.
+     */
+    int parallelSegments = 1;
+
+    /**
+     * @brief Receives the progress of downloads; may be empty.
+     */
+    ProgressCallback progressCallback;
+
+    /**
+     * @brief Cancels the downloads of this downloader.
+     */
+    CancellationToken cancellation;
+
+    /**
+     * @brief Validators of the copy the caller already has; sent as `If-None-Match` / `If-Modified-Since`.
+     */
+    HttpValidators conditionalValidators;
+
+    /**
+     * @brief Whether the last download was answered with 304 Not Modified.
+     */
+    bool notModified = false;
+
+    /**
+     * @brief Validators of the response the last downloaded file came from.
+     */
+    HttpValidators responseValidators;
+
+    /**
+     * @brief MD5 and length the server reported for the last downloaded file.
+     */
+    ContentFingerprint responseFingerprint;
+
+    /**
+     * @brief SHA-256 of the last downloaded file, computed while it was received.
+     */
+    std::optional<std::string> contentSha256;
+
+    /**
+     * @brief MD5 and length the downloaded content must have; empty if it is not verified.
+     */
+    ContentFingerprint expectedContent;
+
+    /// Smallest range worth a connection of its own.
+    static constexpr uint64_t kMinSegmentSize = 4ull * 1024 * 1024;
+    /// Longest time a segmented download waits before it checks its segments again.
+    static constexpr int kSegmentPollMs = 100;
+
+    struct SlistDeleter {
+        void operator()(curl_slist* list) const {
+            curl_slist_free_all(list);
+        }
+    };
+
+    enum class SegmentedResult {
+        Done,        ///< The file was downloaded and moved into place.
+        NotModified, ///< The server answered the conditional probe with 304.
+        Failed,      ///< A segment failed after all retries.
+        Unsupported  ///< The server does not serve ranges; download in a single stream instead.
+    };
+
+    struct Segment;
+
+    /**
+     * @brief State shared by the segments of one download.
+     *
+     * While the segments run, it is only used by their callbacks on the `TransferLoop` thread.
+     */
+    struct SegmentGroup {
+        FileDownloader* owner = nullptr;
+        std::vector<Segment>* segments = nullptr;
+        uint64_t reported = 0;  ///< Bytes received when progress was last reported.
+
+        /// Passes the progress to the progress callback if more bytes arrived since the last report.
+        void ReportProgress() {
+            if (!owner->progressCallback) {
+                return;
+            }
+            uint64_t received = 0;
+            uint64_t total = 0;
+            for (const Segment& segment : *segments) {
+                received += segment.position - segment.begin;
+                total += segment.end - segment.begin;
+            }
+            if (received > reported) {
+                reported = received;
+                owner->progressCallback(received, total);
+            }
+        }
+    };
+
+    /**
+     * @brief One byte range `[position, end)` of a segmented download and its transfer.
+     */
+    struct Segment {
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        uint64_t position = 0;   ///< Next byte to receive.
+        uint64_t requested = 0;  ///< Position the current request started at.
+        int failures = 0;
+        bool rangeRejected = false;
+        DownloadSink file;       ///< Writes the range at its offset in the partial file.
+        CurlHandle curl;
+        std::unique_ptr<curl_slist, SlistDeleter> headerList;
+        HttpResponseHeaders headers;
+        std::string range;
+        std::chrono::steady_clock::time_point retryAt{};
+        DigestStream* digest = nullptr;  ///< Digest of the whole file, shared by all segments.
+        SegmentGroup* group = nullptr;
+        std::future<CURLcode> result;    ///< Result of the running transfer; invalid while none runs.
+    };
+
+    /**
+     * @brief Writes the body of a range response at its offset in the partial file.
+     *
+     * The first chunk of every response is checked against the requested range; a response
+     * that is not a 206 for exactly that range (for example because the file changed and the
+     * `If-Range` validator no longer matched) aborts the segment. Data at the end of the
+     * bytes hashed so far is added to the digest of the file right away, and the digest moves
+     * on when the segment completes (see `AdvanceDigest()`). The bandwidth limit may pause the
+     * transfer. Runs on the `TransferLoop` thread, like the callbacks of all other segments.
+     */
+    static size_t SegmentWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        Segment* segment = static_cast<Segment*>(userp);
+        const size_t length = size * nmemb;
+        if (!contents || !segment) {
+            LOG_ERROR("SegmentWriteCallback: Invalid pointer passed.");
+            return 0;
+        }
+        if (TransferLoop::Instance().PauseForBandwidth(segment->curl.get(), length)) {
+            return CURL_WRITEFUNC_PAUSE;
+        }
+
+        if (segment->position == segment->requested) {
+            auto contentRange = segment->headers.Get("Content-Range");
+            std::string expected = "bytes " + std::to_string(segment->requested) + "-";
+            if (segment->headers.Status() != 206 || !contentRange || contentRange->rfind(expected, 0) != 0) {
+                segment->rangeRejected = true;
+                return 0;
+            }
+        }
+        if (length > segment->end - segment->position) {
+            LOG_ERROR("Server sent more data than requested for range {}.", segment->range);
+            return 0;
+        }
+
+        if (!segment->file.Write(contents, length)) {
+            LOG_ERROR("SegmentWriteCallback: Failed to write at offset {}.", segment->position);
+            return 0;
+        }
+        if (segment->digest && segment->digest->Bytes() == segment->position) {
+            segment->digest->Update(contents, length);
+        }
+        segment->position += length;
+        if (segment->position == segment->end) {
+            AdvanceDigest(*segment->group->segments);
+        }
+        segment->group->ReportProgress();
+        return length;
+    }
+
+    /**
+     * @brief Checks downloaded content against the fingerprint set with `setExpectedContent()`.
+     *
+     * @param md5 MD5 of the content, computed during the transfer; finalized here.
+     * @param length Length of the content.
+     * @return true if nothing is expected, or the content matches.
+     */
+    bool VerifyExpectedContent(DigestStream* md5, uint64_t length) const {
+        if (expectedContent.Empty()) {
+            return true;
+        }
+
+        auto expected = HashEngine::Base64ToHex(expectedContent.md5);
+        auto actual = md5 ? md5->Finish() : std::nullopt;
+        if (!expected || !actual || *expected != *actual || length != expectedContent.length) {
+            LOG_ERROR("Content from {} does not match the expected MD5 {} and length {}; discarding it.",
+                url, expectedContent.md5, expectedContent.length);
+
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns true if the download was cancelled, or all transfers are being aborted.
+     */
+    bool IsCancelled() const {
+        return cancellation.IsCancelled() || TransferLoop::Instance().IsStopping();
+    }
+
+    /**
+     * @brief Waits before a retry, returning early if the download is cancelled.
+     * @return false if the download was cancelled.
+     */
+    bool WaitBeforeRetry(std::chrono::milliseconds delay) const {
+        // Sleep in slices, so that TransferLoop::AbortAll() is noticed as well as the token
+        const auto until = std::chrono::steady_clock::now() + delay;
+        while (!IsCancelled()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+            if (left <= std::chrono::milliseconds::zero()) {
+                return true;
+            }
+            cancellation.SleepFor(std::min(left, std::chrono::milliseconds(250)));
+        }
+        LOG_WARN("Download of {} was cancelled.", url);
+
+        return false;
+    }
+
+    /**
+     * @brief Passes the progress of a transfer to the progress callback.
+     *
+     * Installed as `CURLOPT_XFERINFOFUNCTION` with a `Transfer` or `MemoryTransfer`. The
+     * offset the transfer resumed from is added, so the callback sees the progress of the
+     * whole file. Returning non-zero aborts a cancelled transfer from within curl.
+     */
+    template <typename TransferType>
+    static int TransferProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t, curl_off_t) {
+        TransferType* transfer = static_cast<TransferType*>(clientp);
+        if (transfer->owner->IsCancelled()) {
+            return 1;
+        }
+        if (transfer->owner->progressCallback && dlnow > 0) {
+            const uint64_t offset = transfer->resumeOffset;
+            transfer->owner->progressCallback(offset + static_cast<uint64_t>(dlnow),
+                dltotal > 0 ? offset + static_cast<uint64_t>(dltotal) : 0);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Aborts a segment or probe transfer of a cancelled download from within curl.
+     */
+    static int CancelCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<const FileDownloader*>(clientp)->IsCancelled() ? 1 : 0;
+    }
+
+    /**
+     * @brief Sets how long a transfer of the file body may take.
+     *
+     * A throttled download (see `BandwidthLimiter`) can legitimately take much longer than
+     * `timeoutSeconds`, so while a bandwidth limit is configured only transfers that stall
+     * for `timeoutSeconds` are aborted, rather than every transfer that takes that long.
+     */
+    void ApplyTransferTimeout(CURL* curl) const {
+        if (BandwidthLimiter::Instance().HasLimits()) {
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, static_cast<long>(timeoutSeconds));
+            return;
+        }
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeoutSeconds);
+    }
+
+    /**
+     * @brief Checks whether a partial file from an earlier single-stream attempt can be resumed.
+     */
+    bool HasResumablePartial(const fs::path& destination) const {
+        auto state = PartialDownloadState::Load(destination);
+        std::error_code ec;
+        return state && state->url == UrlWithoutQuery(url) && fs::exists(PartialDownloadState::PartialPath(destination), ec);
+    }
+
+    /**
+     * @brief Issues a HEAD request for the URL and collects the response headers.
+     */
+    bool ProbeResource(HttpResponseHeaders& headers) {
+        CurlHandle curl = CurlPool::Instance().Acquire();
+        if (!curl) {
+            return false;
+        }
+
+        std::unique_ptr<curl_slist, SlistDeleter> conditional(AppendConditionalHeaders(nullptr));
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, conditional.get());
+        curl_easy_setopt(curl.get(), CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, HttpResponseHeaders::HeaderCallback);
+        curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &headers);
+        curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, 0L);
+        curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, timeoutSeconds);
+        curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+
+        return TransferLoop::Instance().Perform(curl.get(), cancellation).get() == CURLE_OK && (headers.Status() == 200 || headers.Status() == 304);
+    }
+
+    /**
+     * @brief Appends `If-None-Match` / `If-Modified-Since` for the validators set with `setConditionalValidators()`.
+     * @return The extended list (may still be null if there are no validators).
+     */
+    curl_slist* AppendConditionalHeaders(curl_slist* list) const {
+        if (!conditionalValidators.etag.empty()) {
+            list = curl_slist_append(list, ("If-None-Match: " + conditionalValidators.etag).c_str());
+        }
+        if (!conditionalValidators.lastModified.empty()) {
+            list = curl_slist_append(list, ("If-Modified-Since: " + conditionalValidators.lastModified).c_str());
+        }
+        return list;
+    }
+
+    /**
+     * @brief Starts (or restarts) the transfer of the remaining bytes of a segment on the `TransferLoop`.
+     *
+     * @param abort Token that aborts the transfers of all segments.
+     */
+    bool StartSegment(Segment& segment, const std::string& ifRange, const CancellationToken& abort) {
+        segment.curl = CurlPool::Instance().Acquire();
+        if (!segment.curl) {
+            return false;
+        }
+
+        segment.headers.Clear();
+        segment.requested = segment.position;
+        segment.range = std::to_string(segment.position) + "-" + std::to_string(segment.end - 1);
+        segment.headerList.reset(ifRange.empty() ? nullptr : curl_slist_append(nullptr, ("If-Range: " + ifRange).c_str()));
+
+        CURL* curl = segment.curl.get();
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_RANGE, segment.range.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, segment.headerList.get());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, SegmentWriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &segment);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HttpResponseHeaders::HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &segment.headers);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        ApplyTransferTimeout(curl);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+
+        segment.result = TransferLoop::Instance().Perform(curl, abort);
+        return true;
+    }
+
+    /**
+     * @brief Downloads the file as concurrent range requests on the `TransferLoop`.
+     *
+     * A HEAD request determines the size of the file and whether the server serves byte
+     * ranges. The disk space for the partial file is checked and preallocated, and every
+     * segment writes its range at its own offset through a `DownloadSink` of its own; the
+     * SHA-256 of the file is computed along the way (see `AdvanceDigest()`). A segment that
+     * fails with a transient error is restarted from the last byte it received, after the
+     * delay chosen by the retry policy. All ranges carry the validator of the HEAD response in
+     * `If-Range`, so a file that changes during the download cannot be assembled from two
+     * versions; the download then falls back to a single stream.
+     *
+     * @return Whether the download succeeded, failed, or has to be done in a single stream.
+     */
+    SegmentedResult DownloadSegmented(const fs::path& destination) {
+        HttpResponseHeaders probe;
+        if (!ProbeResource(probe)) {
+            LOG_WARN("HEAD request for {} failed; downloading in a single stream.", url);
+
+            return SegmentedResult::Unsupported;
+        }
+
+        if (probe.Status() == 304) {
+            LOG_INFO("{} is unchanged on the server (304); nothing was downloaded.", url);
+
+            notModified = true;
+            responseValidators = probe.Validators();
+            return SegmentedResult::NotModified;
+        }
+
+        auto size = probe.ContentLength();
+        auto acceptRanges = probe.Get("Accept-Ranges");
+        if (!size || !acceptRanges || *acceptRanges != "bytes") {
+            LOG_INFO("Server does not advertise byte ranges for {}; downloading in a single stream.", url);
+
+            return SegmentedResult::Unsupported;
+        }
+
+        const uint64_t segmentCount = std::min<uint64_t>(parallelSegments, *size / kMinSegmentSize);
+        if (segmentCount < 2) {
+            return SegmentedResult::Unsupported;
+        }
+
+        const fs::path partialPath = PartialDownloadState::PartialPath(destination);
+        PartialDownloadState::Discard(destination);
+        // Windows drops the preallocation past the end of the file when the handle that made
+        // it is closed, so the reserving handle stays open until the segments are written.
+        DownloadSink reservation;
+        if (!reservation.Open(partialPath, 0, true) || !reservation.Reserve(*size)) {
+            reservation.Close();
+            PartialDownloadState::Discard(destination);
+            return SegmentedResult::Failed;
+        }
+
+        LOG_INFO("Downloading {} bytes from {} in {} segments.", *size, url, segmentCount);
+
+        const std::string ifRange = probe.Validators().IfRangeValue();
+        const uint64_t segmentSize = (*size + segmentCount - 1) / segmentCount;
+        DigestStream digest;
+        std::vector<Segment> segments(static_cast<size_t>(segmentCount));
+        for (size_t i = 0; i < segments.size(); ++i) {
+            segments[i].begin = segments[i].position = i * segmentSize;
+            segments[i].end = std::min(*size, (i + 1) * segmentSize);
+            segments[i].digest = &digest;
+            if (!segments[i].file.Open(partialPath, segments[i].begin, false)) {
+                segments.clear();
+                reservation.Close();
+                PartialDownloadState::Discard(destination);
+                return SegmentedResult::Failed;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        SegmentedResult result = RunSegments(segments, ifRange);
+        // Syncing the last handle flushes the whole file, after all segments were written out
+        for (size_t i = 0; i < segments.size(); ++i) {
+            bool sync = result == SegmentedResult::Done && i + 1 == segments.size();
+            if (!segments[i].file.Close(sync) && result == SegmentedResult::Done) {
+                result = SegmentedResult::Failed;
+            }
+        }
+        reservation.Close();
+
+        if (result != SegmentedResult::Done) {
+            PartialDownloadState::Discard(destination);
+            return result;
+        }
+
+        LOG_INFO("Downloaded {} segments in {:.1f} s.", segments.size(),
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        responseValidators = probe.Validators();
+        responseFingerprint = probe.Fingerprint();
+        if (digest.Bytes() == *size) {
+            contentSha256 = digest.Finish();
+        }
+        return Finalize(destination) ? SegmentedResult::Done : SegmentedResult::Failed;
+    }
+
+    /**
+     * @brief Moves the digest of a segmented download forward over the bytes received so far.
+     *
+     * SHA-256 consumes the file in order, so the digest follows the contiguous prefix of the
+     * file. The segment the digest has reached hashes its data as it arrives (see
+     * `SegmentWriteCallback()`). When that segment completes, the digest moves into the next
+     * one, which has been downloading in parallel. The bytes that segment already received
+     * are read back once, while they are still in the page cache, and from then on it also
+     * hashes in-stream. The digest is therefore complete when the last segment is.
+     *
+     * Called by `SegmentWriteCallback()` when a segment completes, on the `TransferLoop`
+     * thread, which runs the callbacks of all segments.
+     */
+    static void AdvanceDigest(std::vector<Segment>& segments) {
+        for (Segment& segment : segments) {
+            DigestStream* digest = segment.digest;
+            if (!digest || digest->Bytes() >= segment.end) {
+                continue;
+            }
+            if (digest->Bytes() >= segment.begin && digest->Bytes() < segment.position) {
+                const uint64_t from = digest->Bytes();
+                if (segment.file.Flush()) {
+                    digest->UpdateFromFile(segment.file.Path(), from, segment.position - from);
+                }
+            }
+            if (digest->Bytes() < segment.end) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Drives the segment transfers until all are complete, one fails for good, or the
+     *        download is cancelled.
+     *
+     * The transfers run on the `TransferLoop`; this thread only collects their results and
+     * restarts failed segments once their retry delay has passed. Before it returns, every
+     * transfer still running is aborted and waited for, so none outlives the segments.
+     */
+    SegmentedResult RunSegments(std::vector<Segment>& segments, const std::string& ifRange) {
+        SegmentGroup group{ this, &segments };
+        for (Segment& segment : segments) {
+            segment.group = &group;
+            // Progress is only reported once data arrives; bytes resumed from disk are not progress
+            group.reported += segment.position - segment.begin;
+        }
+
+        CancellationToken abort;
+        SegmentedResult result = DriveSegments(segments, ifRange, abort);
+        abort.Cancel();
+        for (Segment& segment : segments) {
+            if (segment.result.valid()) {
+                segment.result.wait();
+                segment.result = {};
+                segment.curl.reset();
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Starts the segments and handles their results; see `RunSegments()`.
+     */
+    SegmentedResult DriveSegments(std::vector<Segment>& segments, const std::string& ifRange, const CancellationToken& abort) {
+        const auto started = RetryPolicy::Clock::now();
+        for (Segment& segment : segments) {
+            if (!StartSegment(segment, ifRange, abort)) {
+                return SegmentedResult::Failed;
+            }
+        }
+
+        size_t remaining = segments.size();
+        while (remaining > 0) {
+            if (IsCancelled()) {
+                LOG_WARN("Segmented download of {} was cancelled.", destinationPath);
+
+                return SegmentedResult::Failed;
+            }
+
+            for (Segment& segment : segments) {
+                if (!segment.result.valid() || segment.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    continue;
+                }
+
+                CURLcode res = segment.result.get();
+                long response_code = 0;
+                curl_easy_getinfo(segment.curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+                segment.curl.reset();
+
+                if (res == CURLE_OK && segment.position == segment.end) {
+                    --remaining;
+                    continue;
+                }
+                if (segment.rangeRejected) {
+                    LOG_WARN("Server did not honor range {}; downloading in a single stream.", segment.range);
+
+                    return SegmentedResult::Unsupported;
+                }
+
+                HandleCurlError(res, response_code);
+                std::optional<std::chrono::milliseconds> delay;
+                if (res != CURLE_OK && RetryPolicy::IsRetryable(res, response_code)) {
+                    delay = retryPolicy.NextDelay(++segment.failures, started, RetryPolicy::RetryAfter(segment.headers));
+                }
+                if (!delay) {
+                    LOG_ERROR("Range {} of {} failed.", segment.range, url);
+
+                    return SegmentedResult::Failed;
+                }
+                segment.retryAt = std::chrono::steady_clock::now() + *delay;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            for (Segment& segment : segments) {
+                if (!segment.result.valid() && segment.position < segment.end && segment.retryAt <= now) {
+                    LOG_WARN("Retrying range {}-{} from byte {}.", segment.begin, segment.end - 1, segment.position);
+
+                    if (!StartSegment(segment, ifRange, abort)) {
+                        return SegmentedResult::Failed;
+                    }
+                }
+            }
+
+            if (remaining > 0) {
+                cancellation.SleepFor(std::chrono::milliseconds(kSegmentPollMs));
+            }
+        }
+        return SegmentedResult::Done;
+    }
+
+
+    /**
+     * @brief State of one in-memory transfer attempt, shared with the `libcurl` callbacks.
+     */
+    struct MemoryTransfer {
+        FileDownloader* owner = nullptr;
+        std::string* buffer = nullptr;
+        uint64_t maxSize = 0;
+        bool tooLarge = false;
+        HttpResponseHeaders headers;
+        DigestStream digest{ EVP_sha256() };  ///< SHA-256 of the body received so far.
+        std::unique_ptr<DigestStream> md5;  ///< MD5 of the body, if it is verified.
+        CURL* curl = nullptr;               ///< Easy handle of the attempt.
+        static constexpr uint64_t resumeOffset = 0;  ///< In-memory downloads always start at the beginning.
+    };
+
+    /**
+     * @brief Appends the body of a response to the memory buffer of a `MemoryTransfer`.
+     *
+     * The buffer is reserved from `Content-Length` on the first chunk. A body larger than
+     * the limit of the transfer aborts it. The bandwidth limit may pause the transfer.
+     */
+    static size_t MemoryWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        MemoryTransfer* transfer = static_cast<MemoryTransfer*>(userp);
+        const size_t length = size * nmemb;
+        if (!contents || !transfer) {
+            LOG_ERROR("MemoryWriteCallback: Invalid pointer passed.");
+            return 0;
+        }
+        if (TransferLoop::Instance().PauseForBandwidth(transfer->curl, length)) {
+            return CURL_WRITEFUNC_PAUSE;
+        }
+
+        if (transfer->buffer->empty()) {
+            auto contentLength = transfer->headers.ContentLength();
+            if (contentLength && *contentLength <= transfer->maxSize) {
+                transfer->buffer->reserve(static_cast<size_t>(*contentLength));
+            }
+        }
+        if (transfer->buffer->size() + length > transfer->maxSize) {
+            transfer->tooLarge = true;
+            return 0;
+        }
+
+        transfer->buffer->append(static_cast<const char*>(contents), length);
+        transfer->digest.Update(contents, length);
+        if (transfer->md5) {
+            transfer->md5->Update(contents, length);
+        }
+        return length;
+    }
+
+    /**
+     * @brief State of one transfer attempt, shared with the `libcurl` callbacks.
+     */
+    struct Transfer {
+        Transfer(const std::string& url, const fs::path& destination)
+            : destination(destination), partialPath(PartialDownloadState::PartialPath(destination)) {
+            state.url = UrlWithoutQuery(url);
+        }
+
+        FileDownloader* owner = nullptr;
+        fs::path destination;
+        fs::path partialPath;
+        DownloadSink file;
+        HttpResponseHeaders headers;
+        DigestStream digest;        ///< SHA-256 of the partial file, including this attempt.
+        std::unique_ptr<DigestStream> md5;  ///< MD5 of the partial file, if the content is verified.
+        PartialDownloadState state;
+        uint64_t resumeOffset = 0;  ///< Bytes already in the partial file when the attempt started.
+        uint64_t received = 0;      ///< Bytes received during this attempt.
+        CURL* curl = nullptr;       ///< Easy handle of the attempt.
+
+        /**
+         * @brief Opens the partial file for the body of the response and persists the download state.
+         *
+         * Called before the first chunk of the body is written, so a response without a body
+         * (such as a 304) leaves the disk untouched. A response other than 206 to a resumed
+         * transfer carries the whole resource, so the partial file is truncated. If the response
+         * has no validator, the transfer cannot be resumed later and no state is recorded.
+         * If the size of the resource is known, the disk space for it is checked and reserved;
+         * a download that does not fit fails before anything is written. A resumed transfer
+         * hashes the part of the file that is already on disk, so its digest covers the whole file.
+         */
+        bool BeginBody() {
+            if (resumeOffset > 0 && headers.Status() != 206) {
+                LOG_WARN("Server sent the whole file instead of the requested range; restarting {}.",
+                    partialPath.string());
+
+                resumeOffset = 0;
+            }
+
+            if (!file.Open(partialPath, resumeOffset, resumeOffset == 0)) {
+                return false;
+            }
+            // The bytes of earlier attempts are hashed once here, the rest as it arrives
+            if (!digest.UpdateFromFile(partialPath, 0, resumeOffset) ||
+                (md5 && !md5->UpdateFromFile(partialPath, 0, resumeOffset))) {
+                return false;
+            }
+
+            HttpValidators validators = headers.Validators();
+            if (!validators.Empty() || headers.Status() != 206) {
+                state.validators = validators;
+            }
+            if (auto size = headers.ResourceSize(); size || headers.Status() != 206) {
+                state.totalSize = size.value_or(0);
+            }
+            if (state.totalSize > 0 && !file.Reserve(state.totalSize)) {
+                return false;
+            }
+            if (state.validators.IfRangeValue().empty()) {
+                std::error_code ec;
+                fs::remove(PartialDownloadState::StatePath(destination), ec);
+                return true;
+            }
+            state.Save(destination);
+            return true;
+        }
+    };
+
+    /**
+     * @brief Returns the number of bytes a download can be resumed from.
+     *
+     * A partial file is only resumed if its state record names the same URL and holds a
+     * validator for `If-Range`. Otherwise the leftovers are removed and 0 is returned.
+     *
+     * @param destination The destination of the download.
+     * @param state Receives the recorded state if the download can be resumed.
+     * @return The size of the partial file, or 0 to start from the beginning.
+     */
+    uint64_t ResumableOffset(const fs::path& destination, PartialDownloadState& state) {
+        auto recorded = PartialDownloadState::Load(destination);
+        const fs::path partialPath = PartialDownloadState::PartialPath(destination);
+        std::error_code ec;
+        uint64_t size = fs::exists(partialPath, ec) ? fs::file_size(partialPath, ec) : 0;
+        if (ec || size == 0 || !recorded || recorded->url != UrlWithoutQuery(url) || recorded->validators.IfRangeValue().empty() ||
+            (recorded->totalSize != 0 && size > recorded->totalSize)) {
+            PartialDownloadState::Discard(destination);
+            return 0;
+        }
+
+        state = *recorded;
+        return size;
+    }
+
+    /**
+     * @brief Moves a completed partial file to its destination and removes its state record.
+     */
+    bool Finalize(const fs::path& destination) {
+        try {
+            fs::rename(PartialDownloadState::PartialPath(destination), destination);
+            std::error_code ec;
+            fs::remove(PartialDownloadState::StatePath(destination), ec);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Failed to move completed download to {}: {}", destination.string(), e.what());
+
+            return false;
+        }
+
+        LOG_INFO("Download successful: {}", destination.string());
+
+        return true;
+    }
 
     /**
      * @brief Handles `libcurl` errors and HTTP response codes.
@@ -280,13 +1387,18 @@ private:
         case 403:
             LOG_ERROR("Access forbidden (403).");
 
+            break;
+        case 408:
+        case 429:
+            LOG_WARN("Server is busy or timed out ({}), retrying...", response_code);
+
             break;
         default:
             if (response_code >= 500 && response_code <= 599) {
                 LOG_WARN("Server error ({}), retrying...", response_code);
 
             }
-            else {
+            else if (response_code >= 300) {
                 LOG_ERROR("Unexpected HTTP response ({}).", response_code);
 
             }
@@ -1,244 +1,627 @@
 #include "FileHasher.h"
 #include <string>
-#include <regex>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <sodium.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    constexpr int64_t kFingerprintTicksPerSecond = 10000000;     // FILETIME resolution (100 ns)
+#else
+    constexpr int64_t kFingerprintTicksPerSecond = 1000000000;   // timespec resolution (1 ns)
+#endif
+
+    /// A file written this close to the moment it was hashed may change again without its
+    /// write time moving (coarse timestamp granularity), so such snapshots are not trusted.
+    constexpr int64_t kRacyWindowSeconds = 2;
+
+    /// Domain separation prefixes of Merkle leaves and inner nodes.
+    constexpr unsigned char kMerkleLeafPrefix = 0x00;
+    constexpr unsigned char kMerkleNodePrefix = 0x01;
+
+    /// Files with fewer blocks than this are not worth a block-level comparison.
+    constexpr uint64_t kMinBlocksForDiff = 2;
+
+    /**
+     * @brief Checks whether the processor implements the x86 SHA extensions.
+     *
+     * With them, OpenSSL's SHA-256 is faster than BLAKE2b, so hashing with BLAKE2b first
+     * would only add work.
+     */
+    bool HasShaExtensions() {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        int info[4] = {};
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 29)) != 0;
+#elif defined(__i386__) || defined(__x86_64__)
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx & (1u << 29)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Computes the inner Merkle node SHA-256(0x01 || left || right).
+     */
+    std::optional<std::vector<unsigned char>> CombineMerkleNodes(const std::vector<unsigned char>& left,
+        const std::vector<unsigned char>& right) {
+        std::vector<unsigned char> input;
+        input.reserve(1 + left.size() + right.size());
+        input.push_back(kMerkleNodePrefix);
+        input.insert(input.end(), left.begin(), left.end());
+        input.insert(input.end(), right.begin(), right.end());
+
+        std::vector<unsigned char> digest(EVP_MAX_MD_SIZE);
+        unsigned int lengthOfHash = 0;
+        if (EVP_Digest(input.data(), input.size(), digest.data(), &lengthOfHash, EVP_sha256(), nullptr) != 1) {
+            return std::nullopt;
+        }
+        digest.resize(lengthOfHash);
+        return digest;
+    }
+
+    /**
+     * @brief Runs `task(i)` for every index in [0, count) on at most `maxWorkers` threads.
+     *
+     * The calling thread takes part in the work. If additional threads cannot be started,
+     * the remaining work is done by the threads that are running.
+     */
+    template <typename Task>
+    void ParallelFor(size_t count, size_t maxWorkers, Task&& task) {
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                task(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        size_t workers = std::min(count, std::max<size_t>(maxWorkers, 1));
+        for (size_t t = 1; t < workers; ++t) {
+            try {
+                threads.emplace_back(worker);
+            }
+            catch (const std::system_error& e) {
+                LOG_WARN("Failed to start hashing worker thread: {}", e.what());
+                break;
+            }
+        }
+
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+std::atomic<size_t> FileHasher::s_maxHashConcurrency{ 0 };
+std::atomic<ReadStrategy> FileHasher::s_readStrategy{ ReadStrategy::Auto };
+
+FileHasher::HashMode FileHasher::DefaultHashMode() {
+    static const HashMode mode = HasShaExtensions() ? HashMode::Sha256Only : HashMode::QuickHashFirst;
+    return mode;
+}
 
 /**
- * @brief Normalizes a file path by replacing multiple backslashes with a single backslash.
+ * @brief Returns the SHA-256 hash of a given file, using the cached snapshot when possible.
  *
- * This function ensures that Windows-style paths are correctly formatted by removing
- * redundant backslashes, making the path more consistent and avoiding potential issues
- * when working with file operations.
+ * Before reading the file, its stat fingerprint (size, write time, change time, file id) is
+ * compared with the snapshot cached in the hash store. If they match, the cached digest is
+ * returned. Otherwise the file is hashed and, if its fingerprint did not change while it was
+ * being read, the new snapshot is cached for the next call.
  *
- * @param path The file path to normalize.
- * @return A normalized file path with redundant backslashes removed.
+ * @param filePath The path to the file whose SHA-256 hash is to be calculated.
+ * @param forceRehash If true, the cache is bypassed and the whole file is hashed.
+ * @return An optional string containing the SHA-256 hash of the file, or `std::nullopt` on failure.
  */
-std::string NormalizePath(const std::string& path) {
-    std::regex doubleBackslash(R"(\\+)");  
-    return std::regex_replace(path, doubleBackslash, R"(\)"); 
+std::optional<std::string> FileHasher::GetFileSHA256(const fs::path& filePath, bool forceRehash) const {
+    return GetSnapshotDigest(filePath, forceRehash, &FileSnapshot::sha256, &ComputeFileSHA256, "SHA-256");
 }
 
 /**
- * @brief Normalizes a wide-character file path by replacing multiple backslashes with a single backslash.
+ * @brief Returns the BLAKE2b-256 hash of a given file, using the cached snapshot when possible.
  *
- * This function performs the same normalization as the `std::string` version but works with
- * `std::wstring` to support Unicode paths.
+ * The digest is cached in the file's snapshot next to its SHA-256 digest, under the same
+ * rules as in `GetFileSHA256()`.
  *
- * @param path The wide-character file path to normalize.
- * @return A normalized wide-character file path with redundant backslashes removed.
+ * @param filePath The path to the file to hash.
+ * @param forceRehash If true, the cache is bypassed and the whole file is hashed.
+ * @return The hex encoded digest, or `std::nullopt` on failure.
  */
-std::wstring NormalizePath(const std::wstring& path) {
-    std::wregex doubleBackslash(L"\\\\+");  
-    return std::regex_replace(path, doubleBackslash, L"\\"); 
+std::optional<std::string> FileHasher::GetFileQuickHash(const fs::path& filePath, bool forceRehash) const {
+    return GetSnapshotDigest(filePath, forceRehash, &FileSnapshot::quickHash, &ComputeFileQuickHash, "BLAKE2b");
+}
+
+/**
+ * @brief Returns one digest of a file's snapshot, computing and caching it if the snapshot lacks it.
+ *
+ * @param filePath The file to hash.
+ * @param forceRehash If true, the cache is bypassed and the whole file is hashed.
+ * @param digestField The snapshot member holding the digest.
+ * @param compute Computes the digest from the file content.
+ * @param digestName Name of the digest, for logging.
+ * @return The hex encoded digest, or `std::nullopt` on failure.
+ */
+std::optional<std::string> FileHasher::GetSnapshotDigest(const fs::path& filePath, bool forceRehash,
+    std::string FileSnapshot::* digestField, std::optional<std::string>(*compute)(const fs::path&),
+    const char* digestName) const {
+    const std::string& key = PathKey::Intern(filePath.string()).String();
+    auto before = QueryStatFingerprint(filePath);
+
+    if (!forceRehash && before) {
+        auto record = m_store->Get(key);
+        if (record && record->snapshot && !((*record->snapshot).*digestField).empty() &&
+            IsSnapshotValid(*record->snapshot, *before)) {
+            LOG_DEBUG("File '{}' unchanged since last hashed, using cached {}.", filePath.string(), digestName);
+
+            return (*record->snapshot).*digestField;
+        }
+    }
+
+    auto digest = compute(filePath);
+    if (!digest || !before) {
+        return digest;
+    }
+
+    auto after = QueryStatFingerprint(filePath);
+    if (after && *after == *before) {
+        FileSnapshot snapshot;
+        snapshot.stat = *before;
+        snapshot.hashedAt = CurrentFingerprintTime();
+        snapshot.*digestField = *digest;
+        m_store->PutSnapshot(key, snapshot);
+    }
+    else {
+        LOG_WARN("File '{}' changed while it was being hashed; digest not cached.", filePath.string());
+    }
+
+    return digest;
 }
 
 /**
  * @brief Computes the SHA-256 hash of a given file.
  *
- * This function reads the content of the specified file in binary mode and calculates its
- * SHA-256 hash using OpenSSL's EVP functions. If the file cannot be opened or hashing fails,
- * it logs an error and returns `std::nullopt`. Otherwise, it returns the computed hash as a
- * hexadecimal string.
+ * The file is read by `HashEngine` (memory-mapped, or through large aligned buffers) and
+ * fed to OpenSSL's EVP SHA-256 in multi-megabyte strides. If the file cannot be read or
+ * hashing fails, an error is logged and `std::nullopt` is returned. Otherwise, the computed
+ * hash is returned as a hexadecimal string.
  *
  * @param filePath The path to the file whose SHA-256 hash is to be calculated.
  * @return An optional string containing the SHA-256 hash of the file, or `std::nullopt` on failure.
  */
-std::optional<std::string> FileHasher::GetFileSHA256(const fs::path& filePath) const {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        LOG_ERROR("Failed to open file for SHA-256 calculation: {}", filePath.string());
+std::optional<std::string> FileHasher::ComputeFileSHA256(const fs::path& filePath) {
+    return HashEngine::DigestFile(filePath, EVP_sha256(), ReadOptions{ GetReadStrategy() });
+}
+
+/**
+ * @brief Computes the BLAKE2b-256 hash of a given file.
+ *
+ * libsodium selects an SSSE3 or AVX2 implementation at run time, which hashes several times
+ * faster than SHA-256 on processors without SHA extensions.
+ *
+ * @param filePath The path to the file to hash.
+ * @return The hex encoded digest, or `std::nullopt` on failure.
+ */
+std::optional<std::string> FileHasher::ComputeFileQuickHash(const fs::path& filePath) {
+    if (sodium_init() < 0) {
+        LOG_ERROR("Failed to initialize libsodium.");
 
         return std::nullopt;
     }
 
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        LOG_ERROR("Failed to create EVP_MD_CTX for hashing.");
+    crypto_generichash_state state;
+    if (crypto_generichash_init(&state, nullptr, 0, crypto_generichash_BYTES) != 0) {
+        LOG_ERROR("Failed to initialize BLAKE2b for file: {}", filePath.string());
 
         return std::nullopt;
     }
 
-    if (EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        LOG_ERROR("Failed to initialize SHA-256 context.");
+    bool ok = HashEngine::ForEachChunk(filePath, [&](const unsigned char* data, size_t size) {
+        return crypto_generichash_update(&state, data, size) == 0;
+        }, ReadOptions{ GetReadStrategy() });
+
+    unsigned char digest[crypto_generichash_BYTES];
+    if (crypto_generichash_final(&state, digest, sizeof(digest)) != 0 || !ok) {
+        LOG_ERROR("Failed to compute BLAKE2b hash for file: {}", filePath.string());
 
         return std::nullopt;
     }
+    return HashEngine::ToHex(digest, sizeof(digest));
+}
 
-    char buffer[8192];
-    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-        if (EVP_DigestUpdate(mdctx, buffer, file.gcount()) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            LOG_ERROR("Failed to update SHA-256 digest.");
+/**
+ * @brief Returns the block-level Merkle tree of a file, using the cached tree when possible.
+ *
+ * The cache works like the one of `GetFileSHA256()`: the tree is reused only while the
+ * file's stat fingerprint matches the one it was computed for, and it is cached only if the
+ * fingerprint did not change while the blocks were being read.
+ *
+ * @param filePath Path to the file to hash.
+ * @param forceRehash If true, the cache is bypassed and every block is hashed.
+ * @return The tree, or `std::nullopt` on failure.
+ */
+std::optional<MerkleTree> FileHasher::GetFileMerkleTree(const fs::path& filePath, bool forceRehash) const {
+    const std::string& key = PathKey::Intern(filePath.string()).String();
+    auto before = QueryStatFingerprint(filePath);
+    if (!before) {
+        LOG_ERROR("Unable to query file for Merkle hashing: {}", filePath.string());
 
-            return std::nullopt;
-        }
+        return std::nullopt;
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int lengthOfHash = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &lengthOfHash) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        LOG_ERROR("Failed to finalize SHA-256 digest.");
+    if (!forceRehash) {
+        auto record = m_store->Get(key);
+        if (record && record->snapshot && record->snapshot->merkle &&
+            record->snapshot->merkle->blockSize == kMerkleBlockSize &&
+            IsSnapshotValid(*record->snapshot, *before)) {
+            LOG_DEBUG("File '{}' unchanged since last hashed, using cached Merkle tree.", filePath.string());
 
-        return std::nullopt;
+            return record->snapshot->merkle;
+        }
     }
 
-    EVP_MD_CTX_free(mdctx);
-    file.close();
+    auto tree = ComputeMerkleTree(filePath, before->size);
+    if (!tree) {
+        return std::nullopt;
+    }
 
-    std::ostringstream oss;
-    for (unsigned int i = 0; i < lengthOfHash; i++) {
-        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    auto after = QueryStatFingerprint(filePath);
+    if (after && *after == *before) {
+        FileSnapshot snapshot;
+        snapshot.stat = *before;
+        snapshot.hashedAt = CurrentFingerprintTime();
+        snapshot.merkle = *tree;
+        m_store->PutSnapshot(key, snapshot);
+    }
+    else {
+        LOG_WARN("File '{}' changed while it was being hashed; Merkle tree not cached.", filePath.string());
     }
 
-    return oss.str();
+    return tree;
+}
+
+std::optional<MerkleTree> FileHasher::GetCachedMerkleTree(const std::string& filePath) const {
+    auto record = m_store->Get(PathKey::Intern(filePath).String());
+    if (!record || !record->snapshot) {
+        return std::nullopt;
+    }
+    return record->snapshot->merkle;
 }
+
 /**
- * @brief Stores or updates the SHA-256 hash of a file in a JSON file.
+ * @brief Hashes the blocks of a file concurrently and combines them into a Merkle tree.
  *
- * This function normalizes the given file path, checks if the JSON file exists, and reads its
- * contents. If the JSON file is corrupted or invalid, it resets it to an empty JSON object.
- * The function then updates the JSON with the new hash, timestamp, and a human-readable timestamp
- * before saving the updated JSON back to the file. The operation is thread-safe using a mutex lock.
+ * Every worker reads its own block range through `HashEngine`, so blocks are hashed
+ * independently of each other. An empty file has a single, empty block.
  *
- * @param fileDirtyPath The original file path (which will be normalized).
- * @param hash The SHA-256 hash of the file.
+ * @param filePath The file to hash.
+ * @param fileSize The size of the file, as seen before hashing.
+ * @return The tree, or `std::nullopt` if any block could not be hashed.
  */
-void FileHasher::StoreFileHash(const std::string& fileDirtyPath, const std::string& hash) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+std::optional<MerkleTree> FileHasher::ComputeMerkleTree(const fs::path& filePath, uint64_t fileSize) {
+    const uint64_t blockSize = kMerkleBlockSize;
+    const size_t blockCount = fileSize == 0 ? 1 : static_cast<size_t>((fileSize + blockSize - 1) / blockSize);
+    const std::string_view leafPrefix(reinterpret_cast<const char*>(&kMerkleLeafPrefix), 1);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<unsigned char>> level(blockCount);
+    std::atomic<bool> failed{ false };
+
+    ParallelFor(blockCount, GetMaxHashConcurrency(), [&](size_t i) {
+        if (failed) {
+            return;
+        }
 
-    std::string filePath = NormalizePath(fileDirtyPath);
-    json j;
+        const uint64_t offset = static_cast<uint64_t>(i) * blockSize;
+        const uint64_t length = std::min(blockSize, fileSize - offset);
+        auto digest = HashEngine::DigestRange(filePath, offset, length, EVP_sha256(), leafPrefix,
+            ReadOptions{ GetReadStrategy() });
+        if (!digest) {
+            failed = true;
+            return;
+        }
+        level[i] = std::move(*digest);
+        });
 
-    if (fs::exists(m_jsonFilePath)) {
-        std::ifstream configFile(m_jsonFilePath);
-        if (configFile.is_open()) {
-            try {
-                configFile >> j;
-                if (!j.is_object()) {
-                    LOG_WARN("JSON file is corrupted, resetting to empty JSON: {}", m_jsonFilePath);
+    if (failed) {
+        LOG_ERROR("Failed to compute Merkle tree of '{}'.", filePath.string());
 
-                    j = json::object();
-                }
-            }
-            catch (const std::exception& e) {
-                LOG_WARN("Invalid JSON format in {}: {}", m_jsonFilePath, e.what());
+        return std::nullopt;
+    }
+
+    MerkleTree tree;
+    tree.blockSize = blockSize;
+    tree.blocks.reserve(blockCount);
+    for (const auto& leaf : level) {
+        tree.blocks.push_back(HashEngine::ToHex(leaf.data(), leaf.size()));
+    }
+
+    while (level.size() > 1) {
+        std::vector<std::vector<unsigned char>> parents;
+        parents.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            auto node = CombineMerkleNodes(level[i], level[i + 1]);
+            if (!node) {
+                LOG_ERROR("Failed to combine Merkle nodes of '{}'.", filePath.string());
 
-                j = json::object();
+                return std::nullopt;
             }
+            parents.push_back(std::move(*node));
         }
-        configFile.close();
+        if (level.size() % 2 != 0) {
+            parents.push_back(std::move(level.back()));
+        }
+        level = std::move(parents);
     }
+    tree.root = HashEngine::ToHex(level[0].data(), level[0].size());
 
-    std::time_t currentTime = std::time(nullptr);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Built Merkle tree of '{}' ({} bytes, {} blocks) in {:.1f} ms, {:.1f} MB/s.", filePath.string(), fileSize,
+        blockCount, seconds * 1000.0, seconds > 0.0 ? static_cast<double>(fileSize) / seconds / 1e6 : 0.0);
 
-    j[filePath] = {
-        {"file_hash", hash},
-        {"timestamp", currentTime},
-        {"readable_timestamp", GetReadableTime(currentTime)}
-    };
+    return tree;
+}
 
-    std::ofstream outFile(m_jsonFilePath);
-    if (!outFile.is_open()) {
-        LOG_ERROR("Failed to open JSON file for writing: {}", m_jsonFilePath);
+std::vector<size_t> FileHasher::DiffMerkleTrees(const MerkleTree& previous, const MerkleTree& current) {
+    std::vector<size_t> changed;
+    if (previous.blockSize == current.blockSize && previous.root == current.root) {
+        return changed;
+    }
 
-        return;
+    const bool comparable = previous.blockSize == current.blockSize;
+    for (size_t i = 0; i < current.blocks.size(); ++i) {
+        if (!comparable || i >= previous.blocks.size() || previous.blocks[i] != current.blocks[i]) {
+            changed.push_back(i);
+        }
     }
+    return changed;
+}
 
-    outFile << j.dump(4);
-    LOG_INFO("Updated file hash for '{}' in JSON file '{}'", filePath, m_jsonFilePath);
+/**
+ * @brief Hashes several files concurrently and returns their digests in input order.
+ *
+ * Work is spread over at most `GetMaxHashConcurrency()` threads. Every file gets its own
+ * result: a missing file or a read error is recorded in `FileHashResult::error` and the
+ * remaining files are still hashed.
+ *
+ * @param filePaths The files to hash.
+ * @param forceRehash Always read and hash the whole files, ignoring cached snapshots.
+ * @return One result per input path, in input order.
+ */
+std::vector<FileHashResult> FileHasher::HashFiles(const std::vector<fs::path>& filePaths, bool forceRehash) const {
+    std::vector<FileHashResult> results(filePaths.size());
+
+    ParallelFor(filePaths.size(), GetMaxHashConcurrency(), [&](size_t i) {
+        FileHashResult& result = results[i];
+        result.path = filePaths[i];
+
+        try {
+            if (!fs::exists(result.path)) {
+                result.error = "File does not exist";
+            }
+            else {
+                result.sha256 = GetFileSHA256(result.path, forceRehash);
+                if (!result.sha256) {
+                    result.error = "Failed to compute SHA-256";
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            result.error = e.what();
+        }
+
+        if (!result.error.empty()) {
+            LOG_ERROR("Failed to hash '{}': {}", result.path.string(), result.error);
+        }
+        });
+
+    return results;
+}
 
+void FileHasher::SetMaxHashConcurrency(size_t maxConcurrency) {
+    s_maxHashConcurrency = maxConcurrency;
 }
 
 /**
- * @brief Retrieves the stored SHA-256 hash of a file from a JSON file.
+ * @brief Returns the number of threads hashing may use.
  *
- * This function normalizes the file path and checks if the JSON file exists. If the JSON file
- * is missing or corrupted, it resets it to an empty JSON object. It then attempts to extract
- * the stored hash for the given file. If the file has an associated hash, it is returned.
- * Otherwise, it logs a warning and returns `std::nullopt`.
+ * Unless overridden with `SetMaxHashConcurrency()`, this is the number of hardware threads,
+ * capped at `kDefaultMaxHashConcurrency`.
+ */
+size_t FileHasher::GetMaxHashConcurrency() {
+    size_t configured = s_maxHashConcurrency;
+    if (configured != 0) {
+        return configured;
+    }
+
+    size_t hardware = std::thread::hardware_concurrency();
+    return std::clamp<size_t>(hardware, 1, kDefaultMaxHashConcurrency);
+}
+
+void FileHasher::SetReadStrategy(ReadStrategy strategy) {
+    s_readStrategy = strategy;
+}
+
+ReadStrategy FileHasher::GetReadStrategy() {
+    return s_readStrategy;
+}
+
+/**
+ * @brief Stores or updates the SHA-256 hash of a file in the hash store.
+ *
+ * This function normalizes the given file path and records the hash together with the
+ * current timestamp in the shared in-memory store. The JSON file is not rewritten here;
+ * the store persists pending records when it is flushed (see `HashStore`).
  *
  * @param fileDirtyPath The original file path (which will be normalized).
- * @return An optional string containing the stored SHA-256 hash, or `std::nullopt` if not found.
+ * @param hash The SHA-256 hash of the file.
+ * @param quickHash The BLAKE2b hash of the same content, or empty if not known.
  */
-std::optional<std::string> FileHasher::GetStoredFileHash(const std::string& fileDirtyPath) const {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void FileHasher::StoreFileHash(const std::string& fileDirtyPath, const std::string& hash, const std::string& quickHash) {
+    PathKey key = PathKey::Intern(fileDirtyPath);
+    const std::string& filePath = key.String();
 
-    std::string filePath = NormalizePath(fileDirtyPath);
+    if (m_batch) {
+        (*m_batch)[key] = HashStore::Update{ filePath, hash, quickHash };
+        LOG_INFO("Staged file hash for '{}' in hash store '{}'", filePath, m_jsonFilePath);
+        return;
+    }
 
-    if (!fs::exists(m_jsonFilePath)) {
-        LOG_WARN("JSON file does not exist, creating an empty JSON file: {}", m_jsonFilePath);
+    m_store->Put(filePath, hash, quickHash);
+    LOG_INFO("Updated file hash for '{}' in hash store '{}'", filePath, m_jsonFilePath);
+}
 
-        ResetJsonFile();
-        return std::nullopt;
+bool FileHasher::StoreFileHashes(const std::map<std::string, std::string>& hashes) {
+    std::vector<HashStore::Update> updates;
+    updates.reserve(hashes.size());
+    for (const auto& [filePath, hash] : hashes) {
+        updates.push_back(HashStore::Update{ PathKey::Intern(filePath).String(), hash, std::string() });
     }
+    return PutUpdates(updates);
+}
 
-    std::ifstream configFile(m_jsonFilePath);
-    if (!configFile.is_open()) {
-        LOG_ERROR("Unable to open JSON file: {}", m_jsonFilePath);
+bool FileHasher::PutUpdates(const std::vector<HashStore::Update>& updates) {
+    if (!m_store->PutBatch(updates)) {
+        LOG_ERROR("Failed to record {} file hashes in hash store '{}'", updates.size(), m_jsonFilePath);
 
-        return std::nullopt;
+        return false;
     }
 
-    json j;
-    try {
-        configFile >> j;
-        configFile.close();
+    LOG_INFO("Updated {} file hashes in hash store '{}'", updates.size(), m_jsonFilePath);
 
-        LOG_INFO("JSON file content: {}", j.dump(4)); 
+    return true;
+}
 
-        if (!j.is_object()) {
-            LOG_WARN("JSON file is corrupted, resetting to an empty JSON: {}", m_jsonFilePath);
+void FileHasher::BeginBatch() {
+    if (m_batch) {
+        LOG_WARN("A hash batch is already open for '{}'", m_jsonFilePath);
+        return;
+    }
+    m_batch.emplace();
+}
 
-            ResetJsonFile();
-            return std::nullopt;
-        }
+bool FileHasher::Commit() {
+    if (!m_batch) {
+        LOG_WARN("No hash batch is open for '{}'", m_jsonFilePath);
+
+        return false;
+    }
 
-        if (j.contains(filePath) && j[filePath].contains("file_hash")) {
-            std::string storedHash = j[filePath]["file_hash"].get<std::string>();
-            LOG_INFO("Retrieved stored hash: {}", storedHash);
+    std::vector<HashStore::Update> staged;
+    staged.reserve(m_batch->size());
+    for (auto& [key, update] : *m_batch) {
+        staged.push_back(std::move(update));
+    }
+    m_batch.reset();
+
+    if (staged.empty()) {
+        return true;
+    }
+    return PutUpdates(staged);
+}
 
-            return storedHash;
+/**
+ * @brief Retrieves the stored SHA-256 hash of a file from the hash store.
+ *
+ * This function normalizes the file path and looks it up in the in-memory index that was
+ * loaded from the JSON file. If the file has an associated hash, it is returned. Otherwise,
+ * it logs a warning and returns `std::nullopt`.
+ *
+ * @param fileDirtyPath The original file path (which will be normalized).
+ * @return An optional string containing the stored SHA-256 hash, or `std::nullopt` if not found.
+ */
+std::optional<std::string> FileHasher::GetStoredFileHash(const std::string& fileDirtyPath) const {
+    PathKey key = PathKey::Intern(fileDirtyPath);
+    const std::string& filePath = key.String();
+
+    if (m_batch) {
+        auto staged = m_batch->find(key);
+        if (staged != m_batch->end()) {
+            LOG_INFO("Retrieved staged hash: {}", staged->second.fileHash);
+
+            return staged->second.fileHash;
         }
+    }
 
+    auto record = m_store->Get(filePath);
+    if (!record || record->fileHash.empty()) {
         LOG_WARN("No hash record found for file: {}", filePath);
 
         return std::nullopt;
     }
-    catch (const std::exception& e) {
-        LOG_ERROR("Failed to read stored hash from JSON: {}", e.what());
 
-        ResetJsonFile();
-        return std::nullopt;
-    }
+    LOG_INFO("Retrieved stored hash: {}", record->fileHash);
+
+    return record->fileHash;
+}
+
+bool FileHasher::IsStoreEmpty() const {
+    return m_store->Empty() && (!m_batch || m_batch->empty());
 }
 
+bool FileHasher::Flush() {
+    return m_store->Flush();
+}
 
 /**
- * @brief Resets the JSON file to an empty object `{}` to prevent data corruption.
+ * @brief Checks whether a file still has the content recorded for it, by BLAKE2b digest only.
  *
- * If the JSON file is found to be missing or corrupted, this function overwrites it with an
- * empty JSON object to maintain integrity. It logs the reset operation and handles any exceptions
- * that might occur.
+ * This is the cheap first tier of change detection: a match means the recorded SHA-256
+ * hash is still the file's and need not be recomputed. A mismatch, or a record without a
+ * BLAKE2b digest, says nothing; the caller then has to compare SHA-256 hashes.
+ *
+ * @param filePath The file to check.
+ * @return true if the file's BLAKE2b digest equals the one recorded with its hash.
  */
-void FileHasher::ResetJsonFile() const {
-    try {
-        std::ofstream resetFile(m_jsonFilePath);
-        if (resetFile.is_open()) {
-            resetFile << "{}";
-            resetFile.close();
-            LOG_INFO("Successfully reset JSON file: {}", m_jsonFilePath);
+bool FileHasher::MatchesStoredQuickHash(const std::string& filePath) const {
+    if (m_hashMode != HashMode::QuickHashFirst) {
+        return false;
+    }
 
-        }
-        else {
-            LOG_ERROR("Failed to reset JSON file: {}", m_jsonFilePath);
+    auto stored = GetStoredHashes(PathKey::Intern(filePath));
+    if (!stored || stored->fileHash.empty() || stored->quickHash.empty()) {
+        return false;
+    }
 
+    auto quickHash = GetFileQuickHash(filePath);
+    return quickHash && *quickHash == stored->quickHash;
+}
+
+/**
+ * @brief Returns the hashes recorded for a key, including a hash staged by an open batch.
+ */
+std::optional<HashStore::Update> FileHasher::GetStoredHashes(const PathKey& key) const {
+    if (m_batch) {
+        auto staged = m_batch->find(key);
+        if (staged != m_batch->end()) {
+            return staged->second;
         }
     }
-    catch (const std::exception& e) {
-        LOG_ERROR("Exception while resetting JSON file: {}", e.what());
 
+    auto record = m_store->Get(key.String());
+    if (!record) {
+        return std::nullopt;
     }
+    return HashStore::Update{ key.String(), record->fileHash, record->quickHash };
 }
 
 /**
@@ -263,6 +646,11 @@ bool FileHasher::HasFileChanged(const std::string& filePath, const std::string&
  * the stored hash in the JSON file if changes are detected. If the file remains unchanged,
  * it avoids unnecessary updates. It also ensures the JSON file exists and contains valid data.
  *
+ * In `HashMode::QuickHashFirst`, both files are first hashed with BLAKE2b. If both digests
+ * equal the one recorded with the stored hash, nothing has changed and no SHA-256 hash is
+ * computed; otherwise the SHA-256 comparison below decides, and the BLAKE2b digest of the
+ * new file is recorded next to its SHA-256 hash.
+ *
  * @param originalFilePath The path to the original file.
  * @param newFilePath The path to the new file for comparison.
  * @param jsonFilePath The path to the JSON file storing file hashes.
@@ -270,26 +658,49 @@ bool FileHasher::HasFileChanged(const std::string& filePath, const std::string&
  */
 bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, const std::string& newFilePath, const std::string& jsonFilePath) {
     FileHasher hasher(jsonFilePath);
+    return hasher.CheckAndUpdateFileHash(originalFilePath, newFilePath);
+}
 
+bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, const std::string& newFilePath) {
     if (!fs::exists(originalFilePath)) {
         LOG_ERROR("Original file does not exist: {}", originalFilePath);
 
         return false;
     }
 
-    auto originalHash = hasher.GetFileSHA256(originalFilePath);
-    if (!originalHash) {
-        LOG_ERROR("Failed to compute hash for original file: {}", originalFilePath);
-
+    if (!fs::exists(newFilePath)) {
+        LOG_ERROR("New file does not exist: {}", newFilePath);
         return false;
     }
 
-    if (!fs::exists(newFilePath)) {
-        LOG_ERROR("New file does not exist: {}", newFilePath);
+    std::string newQuickHash;
+    if (m_hashMode == HashMode::QuickHashFirst) {
+        std::optional<std::string> quickHashes[2];
+        const std::string* paths[2] = { &originalFilePath, &newFilePath };
+        ParallelFor(2, GetMaxHashConcurrency(), [&](size_t i) {
+            quickHashes[i] = GetFileQuickHash(*paths[i]);
+            });
+
+        auto stored = GetStoredHashes(PathKey::Intern(originalFilePath));
+        if (quickHashes[0] && quickHashes[1] && *quickHashes[0] == *quickHashes[1] &&
+            stored && !stored->fileHash.empty() && stored->quickHash == *quickHashes[1]) {
+            LOG_INFO("Original file has not changed (BLAKE2b matches the stored record). No update needed.");
+
+            return false;
+        }
+        newQuickHash = quickHashes[1].value_or(std::string());
+    }
+
+    auto hashes = HashFiles({ originalFilePath, newFilePath });
+
+    const auto& originalHash = hashes[0].sha256;
+    if (!originalHash) {
+        LOG_ERROR("Failed to compute hash for original file: {}", originalFilePath);
+
         return false;
     }
 
-    auto newHash = hasher.GetFileSHA256(newFilePath);
+    const auto& newHash = hashes[1].sha256;
     if (!newHash) {
         LOG_ERROR("Failed to compute hash for new file: {}", newFilePath);
 
@@ -303,10 +714,10 @@ bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, con
         LOG_INFO("File is unchanged. No update needed.");
 
 
-        if (!fs::exists(jsonFilePath)) {
-            LOG_WARN("JSON file '{}' does not exist. Creating new one...", jsonFilePath);
+        if (IsStoreEmpty()) {
+            LOG_WARN("Hash store '{}' is empty. Creating new record...", m_jsonFilePath);
 
-            hasher.StoreFileHash(originalFilePath, *newHash);
+            StoreFileHash(originalFilePath, *newHash, newQuickHash);
             LOG_INFO("JSON record created successfully (no update needed).");
 
         }
@@ -314,20 +725,20 @@ bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, con
         return false;  
     }
 
-    if (!fs::exists(jsonFilePath)) {
-        LOG_WARN("JSON file does not exist, creating new one: {}", jsonFilePath);
+    if (IsStoreEmpty()) {
+        LOG_WARN("Hash store is empty, creating new record: {}", m_jsonFilePath);
 
-        hasher.StoreFileHash(originalFilePath, *newHash);
+        StoreFileHash(originalFilePath, *newHash, newQuickHash);
         LOG_INFO("JSON record created successfully.");
 
         return true;
     }
 
-    auto storedHash = hasher.GetStoredFileHash(originalFilePath);
+    auto storedHash = GetStoredFileHash(originalFilePath);
     if (!storedHash) {
         LOG_WARN("JSON file exists but does not contain valid data. Recreating...");
 
-        hasher.StoreFileHash(originalFilePath, *newHash);
+        StoreFileHash(originalFilePath, *newHash, newQuickHash);
         return true;
     }
     else {
@@ -337,6 +748,10 @@ bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, con
     if ((*storedHash == *newHash) && (*originalHash == *storedHash)) {
         LOG_INFO("Original file has not changed. No update needed.");
 
+        auto stored = GetStoredHashes(PathKey::Intern(originalFilePath));
+        if (!newQuickHash.empty() && stored && stored->quickHash.empty()) {
+            StoreFileHash(originalFilePath, *newHash, newQuickHash);
+        }
         return false;
     }
 
@@ -347,12 +762,43 @@ bool FileHasher::CheckAndUpdateFileHash(const std::string& originalFilePath, con
 
 
     LOG_INFO("Original file has changed. Updating JSON record...");
-    hasher.StoreFileHash(originalFilePath, *newHash);
+    LogChangedBlocks(*this, originalFilePath, newFilePath);
+    StoreFileHash(originalFilePath, *newHash, newQuickHash);
     LOG_INFO("JSON record updated successfully.");
 
     return true;
 }
 
+/**
+ * @brief Logs which blocks of a large file differ between the installed and the new version.
+ *
+ * Building the trees reads both files once more, so this only runs with the `debug` log
+ * level. Small files are skipped: for them "changed" already says everything. The trees are
+ * cached in the hash store, so a later stage can query them without reading the files again.
+ */
+void FileHasher::LogChangedBlocks(const FileHasher& hasher, const std::string& originalFilePath, const std::string& newFilePath) {
+    const auto& logger = Logger::GetLogger();
+    if (!logger || !logger->should_log(spdlog::level::debug)) {
+        return;
+    }
+
+    std::error_code ec;
+    const uint64_t originalSize = fs::file_size(originalFilePath, ec);
+    if (ec || originalSize < kMinBlocksForDiff * kMerkleBlockSize) {
+        return;
+    }
+
+    auto originalTree = hasher.GetFileMerkleTree(originalFilePath);
+    auto newTree = originalTree ? hasher.GetFileMerkleTree(newFilePath) : std::nullopt;
+    if (!originalTree || !newTree) {
+        return;
+    }
+
+    auto changed = DiffMerkleTrees(*originalTree, *newTree);
+    LOG_DEBUG("{} of {} blocks ({} KiB each) differ between '{}' and '{}'.", changed.size(), newTree->blocks.size(),
+        kMerkleBlockSize / 1024, originalFilePath, newFilePath);
+}
+
 /**
  * @brief Creates the directory for storing the hash JSON file if it does not exist.
  *
@@ -367,17 +813,87 @@ void FileHasher::CreateHashDirectory() {
 }
 
 /**
- * @brief Converts a raw time value to a human-readable timestamp format.
+ * @brief Reads the metadata that identifies the current version of a file.
  *
- * This function formats a given `std::time_t` value into a string representation
- * using the format "YYYY-MM-DD HH:MM:SS".
+ * On Windows the file is opened for attribute access only, which does not touch its content.
  *
- * @param rawTime The raw time value to format.
- * @return A formatted string representation of the timestamp.
+ * @param filePath The file to inspect.
+ * @return The fingerprint, or `std::nullopt` if the file cannot be queried.
  */
-std::string FileHasher::GetReadableTime(std::time_t rawTime) {
-    std::tm* timeInfo = std::localtime(&rawTime);
-    std::ostringstream oss;
-    oss << std::put_time(timeInfo, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+std::optional<StatFingerprint> FileHasher::QueryStatFingerprint(const fs::path& filePath) {
+    StatFingerprint fingerprint;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(filePath.c_str(), FILE_READ_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info{};
+    FILE_BASIC_INFO basicInfo{};
+    bool ok = GetFileInformationByHandle(file, &info) &&
+        GetFileInformationByHandleEx(file, FileBasicInfo, &basicInfo, sizeof(basicInfo));
+    CloseHandle(file);
+
+    if (!ok) {
+        return std::nullopt;
+    }
+
+    fingerprint.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    fingerprint.fileId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    fingerprint.volumeId = info.dwVolumeSerialNumber;
+    fingerprint.mtime = basicInfo.LastWriteTime.QuadPart;
+    fingerprint.ctime = basicInfo.ChangeTime.QuadPart;
+#else
+    struct stat st {};
+    if (stat(filePath.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+
+    fingerprint.size = static_cast<uint64_t>(st.st_size);
+    fingerprint.fileId = static_cast<uint64_t>(st.st_ino);
+    fingerprint.volumeId = static_cast<uint64_t>(st.st_dev);
+    fingerprint.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * kFingerprintTicksPerSecond + st.st_mtim.tv_nsec;
+    fingerprint.ctime = static_cast<int64_t>(st.st_ctim.tv_sec) * kFingerprintTicksPerSecond + st.st_ctim.tv_nsec;
+#endif
+
+    return fingerprint;
+}
+
+/**
+ * @brief Returns the current time in the unit used by `StatFingerprint`.
+ */
+int64_t FileHasher::CurrentFingerprintTime() {
+#ifdef _WIN32
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return (static_cast<int64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+#else
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * kFingerprintTicksPerSecond + now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Decides whether a cached snapshot still describes the file on disk.
+ *
+ * Callers check separately that the snapshot holds the digest they need.
+ *
+ * The fingerprint must match exactly, and the file must not have been written or had its
+ * metadata changed within `kRacyWindowSeconds` of the moment it was hashed; otherwise a
+ * modification in the same timestamp tick could go unnoticed.
+ *
+ * @param snapshot The cached snapshot.
+ * @param current The fingerprint of the file as it is now.
+ * @return true if the cached digest can be used, false if the file must be hashed.
+ */
+bool FileHasher::IsSnapshotValid(const FileSnapshot& snapshot, const StatFingerprint& current) {
+    if (snapshot.stat != current) {
+        return false;
+    }
+
+    const int64_t racyWindow = kRacyWindowSeconds * kFingerprintTicksPerSecond;
+    return current.mtime + racyWindow < snapshot.hashedAt && current.ctime + racyWindow < snapshot.hashedAt;
 }
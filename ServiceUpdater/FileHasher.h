@@ -12,22 +12,201 @@
 #include <mutex>
 #include <optional>
 #include <ctime>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <map>
+#include <unordered_map>
 #include "Logger.h"
+#include "HashStore.h"
+#include "HashEngine.h"
+#include "PathKey.h"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+/**
+ * @brief Outcome of hashing one file in a batch.
+ */
+struct FileHashResult {
+    fs::path path;                      ///< The file that was hashed.
+    std::optional<std::string> sha256;  ///< Hex encoded digest, or empty if hashing failed.
+    std::string error;                  ///< Reason of the failure, empty on success.
+};
+
 class FileHasher {
 public:
+    /**
+     * @brief How content changes are detected.
+     */
+    enum class HashMode {
+        /// Always compare SHA-256 hashes.
+        Sha256Only,
+        /// Compare BLAKE2b digests first and compute SHA-256 hashes only if they do not settle it.
+        QuickHashFirst
+    };
+
     explicit FileHasher(const std::string& jsonFilePath)
         : m_jsonFilePath(jsonFilePath) {
         CreateHashDirectory();
+        m_store = HashStore::Open(m_jsonFilePath);
+        m_store->NormalizeKeys([](const std::string& key) { return NormalizePath(key); });
+    }
+
+    /**
+     * @brief Writes any hashes recorded through this instance that are still pending.
+     *
+     * Hashes staged in a batch that was never committed are discarded.
+     */
+    ~FileHasher() {
+        if (m_batch && !m_batch->empty()) {
+            LOG_WARN("Discarding {} uncommitted hash records for '{}'", m_batch->size(), m_jsonFilePath);
+        }
+        if (m_store) {
+            m_store->Flush();
+        }
     }
 
-    [[nodiscard]] std::optional<std::string> GetFileSHA256(const fs::path& filePath) const;
-    void StoreFileHash(const std::string& filePath, const std::string& hash);
+    FileHasher(const FileHasher&) = delete;
+    FileHasher& operator=(const FileHasher&) = delete;
+
+    /**
+     * @brief Returns the SHA-256 hash of a file.
+     *
+     * If the file's size, write time, change time and file id match the snapshot cached in the
+     * hash store, the cached digest is returned without reading the file.
+     *
+     * @param filePath Path to the file to hash.
+     * @param forceRehash Always read and hash the whole file, ignoring the cached snapshot.
+     * @return The hex encoded digest, or `std::nullopt` on failure.
+     */
+    [[nodiscard]] std::optional<std::string> GetFileSHA256(const fs::path& filePath, bool forceRehash = false) const;
+    /**
+     * @brief Returns the BLAKE2b-256 hash of a file, a fast fingerprint of its content.
+     *
+     * Cached in the file's snapshot like the SHA-256 hash of `GetFileSHA256()`.
+     *
+     * @param filePath Path to the file to hash.
+     * @param forceRehash Always read and hash the whole file, ignoring the cached snapshot.
+     * @return The hex encoded digest, or `std::nullopt` on failure.
+     */
+    [[nodiscard]] std::optional<std::string> GetFileQuickHash(const fs::path& filePath, bool forceRehash = false) const;
+    /**
+     * @brief Hashes several files concurrently on a bounded pool of worker threads.
+     *
+     * A failure to hash one file is reported in its result and does not stop the others.
+     *
+     * @param filePaths The files to hash.
+     * @param forceRehash Always read and hash the whole files, ignoring cached snapshots.
+     * @return One result per input path, in input order.
+     */
+    [[nodiscard]] std::vector<FileHashResult> HashFiles(const std::vector<fs::path>& filePaths, bool forceRehash = false) const;
+
+    /**
+     * @brief Returns the block-level Merkle tree of a file, hashing its blocks in parallel.
+     *
+     * The file is split into `kMerkleBlockSize` blocks which are hashed concurrently on up to
+     * `GetMaxHashConcurrency()` threads. The tree is cached in the hash store next to the file's
+     * SHA-256 snapshot and reused while the file's stat fingerprint is unchanged.
+     *
+     * @param filePath Path to the file to hash.
+     * @param forceRehash Always read and hash the whole file, ignoring the cached tree.
+     * @return The tree, or `std::nullopt` on failure.
+     */
+    [[nodiscard]] std::optional<MerkleTree> GetFileMerkleTree(const fs::path& filePath, bool forceRehash = false) const;
+    /**
+     * @brief Returns the Merkle tree last cached for a path, even if the file has changed since.
+     *
+     * Comparing it with the tree of the current content shows which blocks a new version touched.
+     */
+    [[nodiscard]] std::optional<MerkleTree> GetCachedMerkleTree(const std::string& filePath) const;
+    /**
+     * @brief Lists the blocks of `current` whose content differs from `previous`.
+     *
+     * Blocks beyond the end of `previous` count as changed. Trees built with different block
+     * sizes cannot be compared, in which case every block of `current` is reported.
+     *
+     * @return Indices of the changed blocks of `current`, in ascending order.
+     */
+    [[nodiscard]] static std::vector<size_t> DiffMerkleTrees(const MerkleTree& previous, const MerkleTree& current);
+
+    /// Block size of the Merkle trees built by `GetFileMerkleTree()`.
+    static constexpr uint64_t kMerkleBlockSize = 4ull * 1024 * 1024;
+
+    /**
+     * @brief Caps the number of threads used for hashing, process-wide.
+     * @param maxConcurrency Maximum number of worker threads; 0 restores the default.
+     */
+    static void SetMaxHashConcurrency(size_t maxConcurrency);
+    [[nodiscard]] static size_t GetMaxHashConcurrency();
+
+    /**
+     * @brief Selects how files are read for hashing, process-wide.
+     *
+     * `ReadStrategy::Pipelined` keeps several large reads in flight per file; combined with
+     * the worker threads of `HashFiles()` and `GetFileMerkleTree()` this keeps reads queued
+     * across files as well. The default is `ReadStrategy::Auto`.
+     */
+    static void SetReadStrategy(ReadStrategy strategy);
+    [[nodiscard]] static ReadStrategy GetReadStrategy();
+
+    void SetHashMode(HashMode mode) { m_hashMode = mode; }
+    [[nodiscard]] HashMode GetHashMode() const { return m_hashMode; }
+    /**
+     * @brief The mode new instances start in: `QuickHashFirst`, unless the processor has SHA
+     *        extensions, which make SHA-256 faster than BLAKE2b.
+     */
+    [[nodiscard]] static HashMode DefaultHashMode();
+
+    /**
+     * @brief Records the hash of a file, or stages it if a batch is open.
+     * @param filePath The file the hash is recorded for.
+     * @param hash SHA-256 hash of the content.
+     * @param quickHash BLAKE2b hash of the same content, if known. If empty, it is taken from
+     *        the file's cached snapshot when that has the same SHA-256 hash.
+     */
+    void StoreFileHash(const std::string& filePath, const std::string& hash, const std::string& quickHash = {});
+    /**
+     * @brief Records the hashes of several files and writes them to disk as one atomic update.
+     * @param hashes File paths and their SHA-256 hashes.
+     * @return true if all hashes are on disk, false if writing failed.
+     */
+    bool StoreFileHashes(const std::map<std::string, std::string>& hashes);
+
+    /**
+     * @brief Starts collecting hashes in memory instead of recording them one by one.
+     *
+     * Until `Commit()`, `StoreFileHash()` only stages the hash; lookups through this instance
+     * already see staged hashes. An update cycle that records several files should batch them,
+     * so they reach the hash store in a single write and either all or none are recorded.
+     */
+    void BeginBatch();
+    /**
+     * @brief Records all hashes staged since `BeginBatch()` in a single write and closes the batch.
+     * @return true if the staged hashes are on disk (or nothing was staged), false otherwise.
+     */
+    bool Commit();
     [[nodiscard]] std::optional<std::string> GetStoredFileHash(const std::string& filePath) const;
     [[nodiscard]] bool HasFileChanged(const std::string& filePath, const std::string& currentHash) const;
+    /**
+     * @brief Checks, by BLAKE2b digest only, whether a file still has the content whose hash is recorded.
+     *
+     * Always false in `HashMode::Sha256Only` and for records without a BLAKE2b digest, so
+     * false means "compare SHA-256 hashes", not "changed".
+     */
+    [[nodiscard]] bool MatchesStoredQuickHash(const std::string& filePath) const;
+
+    /**
+     * @brief Checks whether the hash store holds any record at all.
+     * @return true if no hash has been recorded yet (or the store was reset), false otherwise.
+     */
+    [[nodiscard]] bool IsStoreEmpty() const;
+
+    /**
+     * @brief Writes pending hash records to the hash store immediately.
+     * @return true if the store is persisted, false if writing failed.
+     */
+    bool Flush();
 
     /**
      * @brief Static method that checks if the original file content has changed and updates the stored hash in JSON.
@@ -37,14 +216,36 @@ public:
      * @return True if the original file has changed and the JSON has been updated, false otherwise.
      */
     static bool CheckAndUpdateFileHash(const std::string& originalFilePath, const std::string& newFilePath, const std::string& jsonFilePath);
+    /**
+     * @brief Same as the static overload, but records the hash through this instance, so it
+     * joins an open batch.
+     */
+    bool CheckAndUpdateFileHash(const std::string& originalFilePath, const std::string& newFilePath);
 
 private:
     std::string m_jsonFilePath;
-    mutable std::mutex m_mutex;
+    std::shared_ptr<HashStore> m_store;
+    /// Hashes staged by an open batch; empty when no batch is open.
+    std::optional<std::unordered_map<PathKey, HashStore::Update>> m_batch;
+    HashMode m_hashMode = DefaultHashMode();
+
+    /// Default cap on hashing threads; hashing competes with Fluent Bit for disk and CPU.
+    static constexpr size_t kDefaultMaxHashConcurrency = 4;
+    static std::atomic<size_t> s_maxHashConcurrency;
+    static std::atomic<ReadStrategy> s_readStrategy;
 
     void CreateHashDirectory();
-    static std::string GetReadableTime(std::time_t rawTime);
-    void ResetJsonFile() const;
+    std::optional<std::string> GetSnapshotDigest(const fs::path& filePath, bool forceRehash, std::string FileSnapshot::* digestField,
+        std::optional<std::string>(*compute)(const fs::path&), const char* digestName) const;
+    std::optional<HashStore::Update> GetStoredHashes(const PathKey& key) const;
+    bool PutUpdates(const std::vector<HashStore::Update>& updates);
+    static std::optional<std::string> ComputeFileSHA256(const fs::path& filePath);
+    static std::optional<std::string> ComputeFileQuickHash(const fs::path& filePath);
+    static std::optional<MerkleTree> ComputeMerkleTree(const fs::path& filePath, uint64_t fileSize);
+    static void LogChangedBlocks(const FileHasher& hasher, const std::string& originalFilePath, const std::string& newFilePath);
+    static std::optional<StatFingerprint> QueryStatFingerprint(const fs::path& filePath);
+    static int64_t CurrentFingerprintTime();
+    static bool IsSnapshotValid(const FileSnapshot& snapshot, const StatFingerprint& current);
 };
 
 #endif // FILEHASHER_H
@@ -56,13 +56,29 @@ public:
                 return false;
             }
 
-            LOG_INFO("Computed hash: {}", *currentHash);
+            return StoreInitialHash(*currentHash);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Error during initial installation process: {}", e.what());
+            return false;
+        }
+    }
 
-            LOG_INFO("Storing initial hash in JSON...");
-            m_fileHasher.StoreFileHash(m_configFilePath, *currentHash);
-            LOG_INFO("Initial hash stored successfully.");
+    /**
+     * @brief Performs the initial installation process with a hash the caller already has.
+     *
+     * Same as `InitialInstall()`, with the SHA-256 hash computed by the caller (e.g. while the
+     * package was downloaded) instead of read from the monitored file.
+     *
+     * @param currentHash Hex encoded SHA-256 hash of the package.
+     * @return true if the hash was stored, false otherwise.
+     */
+    [[nodiscard]] bool InitialInstall(const std::string& currentHash) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        try {
+            LOG_INFO("Starting initial installation process for '{}'", m_configFilePath);
 
-            return true; 
+            return StoreInitialHash(currentHash);
         }
         catch (const std::exception& e) {
             LOG_ERROR("Error during initial installation process: {}", e.what());
@@ -86,40 +102,40 @@ public:
                 return false;
             }
 
+            if (m_fileHasher.MatchesStoredQuickHash(m_configFilePath)) {
+                LOG_INFO("Configuration file is unchanged (BLAKE2b matches the stored record). No restart required.");
+                return false;
+            }
+
             auto currentHash = m_fileHasher.GetFileSHA256(m_configFilePath);
             if (!currentHash) {
                 LOG_ERROR("Failed to compute SHA-256 hash for file: {}", m_configFilePath);
                 return false;
             }
-            LOG_INFO("Computed current hash: {}", *currentHash);
-
-            auto storedHash = m_fileHasher.GetStoredFileHash(m_configFilePath);
-            if (storedHash) {
-                LOG_INFO("Stored hash from JSON: {}", *storedHash);
-            }
-            else {
-                LOG_WARN("No stored hash found in JSON.");
-            }
 
-            LOG_INFO("m_firstTimeHashStored: {}", m_firstTimeHashStored ? "true" : "false");
-
-            if ((!storedHash || storedHash->empty()) && m_firstTimeHashStored) {
-                LOG_INFO("First-time hash detected. Restart required.");
-                m_fileHasher.StoreFileHash(m_configFilePath, *currentHash);
-                m_restartRequired = true;
-                m_firstTimeHashStored = false;  // Resetujemo flag nakon prvog restarta
-                return true;
-            }
+            return CompareWithStoredHash(*currentHash);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Error checking configuration file change: {}", e.what());
+            return false;
+        }
+    }
 
-            if (storedHash && (*storedHash != *currentHash)) {
-                LOG_INFO("Configuration file has changed: {}", m_configFilePath);
-                m_fileHasher.StoreFileHash(m_configFilePath, *currentHash);
-                m_restartRequired = true;
-                return true;
-            }
+    /**
+     * @brief Checks if a package with a hash the caller already has differs from the last recorded state.
+     *
+     * Same as `ShouldRestartService()`, with the SHA-256 hash computed by the caller (e.g. while
+     * the package was downloaded) instead of read from the monitored file.
+     *
+     * @param currentHash Hex encoded SHA-256 hash of the package.
+     * @return True if the package has changed or if it's the first time storing the hash, false otherwise.
+     */
+    [[nodiscard]] bool ShouldRestartService(const std::string& currentHash) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        try {
+            LOG_INFO("Checking if service restart is required...");
 
-            LOG_INFO("Configuration file is unchanged. No restart required.");
-            return false;
+            return CompareWithStoredHash(currentHash);
         }
         catch (const std::exception& e) {
             LOG_ERROR("Error checking configuration file change: {}", e.what());
@@ -168,6 +184,58 @@ private:
     std::atomic<bool> m_restartRequired;   ///< Flag indicating if a restart is necessary.
     bool m_firstTimeHashStored;            ///< ? Flag to track if the hash was just initialized.
 
+    /**
+     * @brief Stores the hash of the package as its initial state. Expects `m_mutex` to be held.
+     */
+    bool StoreInitialHash(const std::string& currentHash) {
+        LOG_INFO("Computed hash: {}", currentHash);
+
+        LOG_INFO("Storing initial hash in JSON...");
+        m_fileHasher.StoreFileHash(m_configFilePath, currentHash);
+        LOG_INFO("Initial hash stored successfully.");
+
+        return true;
+    }
+
+    /**
+     * @brief Compares the hash of the package with the stored one and records it if it changed.
+     *
+     * Expects `m_mutex` to be held.
+     *
+     * @return True if the package has changed or if it's the first time storing the hash.
+     */
+    bool CompareWithStoredHash(const std::string& currentHash) {
+        LOG_INFO("Computed current hash: {}", currentHash);
+
+        auto storedHash = m_fileHasher.GetStoredFileHash(m_configFilePath);
+        if (storedHash) {
+            LOG_INFO("Stored hash from JSON: {}", *storedHash);
+        }
+        else {
+            LOG_WARN("No stored hash found in JSON.");
+        }
+
+        LOG_INFO("m_firstTimeHashStored: {}", m_firstTimeHashStored ? "true" : "false");
+
+        if ((!storedHash || storedHash->empty()) && m_firstTimeHashStored) {
+            LOG_INFO("First-time hash detected. Restart required.");
+            m_fileHasher.StoreFileHash(m_configFilePath, currentHash);
+            m_restartRequired = true;
+            m_firstTimeHashStored = false;  // Resetujemo flag nakon prvog restarta
+            return true;
+        }
+
+        if (storedHash && (*storedHash != currentHash)) {
+            LOG_INFO("Configuration file has changed: {}", m_configFilePath);
+            m_fileHasher.StoreFileHash(m_configFilePath, currentHash);
+            m_restartRequired = true;
+            return true;
+        }
+
+        LOG_INFO("Configuration file is unchanged. No restart required.");
+        return false;
+    }
+
     /**
      * @brief Initializes the monitoring process by checking if the file exists and setting initial hash if needed.
      */
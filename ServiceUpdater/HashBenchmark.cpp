@@ -0,0 +1,347 @@
+#include "HashBenchmark.h"
+#include "FileHasher.h"
+#include "HashStore.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace {
+    constexpr uint64_t kSmallestFileSize = 4 * 1024;
+    constexpr uint64_t kFileSizeFactor = 16;
+    constexpr size_t kStrides[] = { 64 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+    constexpr ReadStrategy kStrategies[] = { ReadStrategy::MemoryMapped, ReadStrategy::BufferedRead, ReadStrategy::Pipelined };
+    /// Store sizes at which lookups, flushing and compaction are measured.
+    constexpr size_t kStoreCheckpoints[] = { 10, 100, 1000, 10000, 100000 };
+    constexpr size_t kLookupsPerCheckpoint = 1000;
+    /// Age a file must reach before `FileHasher` trusts a snapshot of it (its racy window, plus margin).
+    constexpr auto kSnapshotSettleTime = std::chrono::seconds(3);
+
+    using Clock = std::chrono::steady_clock;
+
+    double SecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double MicrosecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    double ThroughputMBps(uint64_t bytes, double seconds) {
+        return seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0;
+    }
+
+    std::string RandomHexDigest(std::mt19937_64& random) {
+        static const char kHexDigits[] = "0123456789abcdef";
+        std::string hex(64, '0');
+        for (size_t i = 0; i < hex.size(); i += 16) {
+            uint64_t bits = random();
+            for (size_t j = 0; j < 16; ++j) {
+                hex[i + j] = kHexDigits[(bits >> (4 * j)) & 0xF];
+            }
+        }
+        return hex;
+    }
+
+    /**
+     * @brief Lowers the log level to warnings for its lifetime, so log output is not measured.
+     */
+    class QuietLogging {
+    public:
+        QuietLogging() {
+            if (auto& logger = Logger::GetLogger()) {
+                m_previous = logger->level();
+                logger->set_level(spdlog::level::warn);
+            }
+        }
+        ~QuietLogging() {
+            if (auto& logger = Logger::GetLogger()) {
+                logger->set_level(m_previous);
+            }
+        }
+
+    private:
+        spdlog::level::level_enum m_previous = spdlog::level::info;
+    };
+}
+
+HashBenchmark::HashBenchmark(HashBenchmarkOptions options)
+    : m_options(std::move(options)) {
+    if (m_options.workDirectory.empty()) {
+        m_options.workDirectory = fs::temp_directory_path();
+    }
+    m_options.repetitions = std::max(m_options.repetitions, 1);
+}
+
+/**
+ * @brief Creates the scratch directory, runs both groups of measurements and removes it again.
+ */
+json HashBenchmark::Run() {
+    const auto startedAt = std::chrono::system_clock::now();
+    m_scratchDirectory = m_options.workDirectory /
+        ("hash_benchmark_" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(startedAt.time_since_epoch()).count()));
+
+    json results = {
+        {"benchmark", "hashing"},
+        {"format_version", 1},
+        {"started_at", std::chrono::duration_cast<std::chrono::seconds>(startedAt.time_since_epoch()).count()},
+        {"system", {
+            {"hardware_threads", std::thread::hardware_concurrency()},
+            {"hash_threads", FileHasher::GetMaxHashConcurrency()},
+            {"default_hash_mode", FileHasher::DefaultHashMode() == FileHasher::HashMode::QuickHashFirst ? "quick_hash_first" : "sha256_only"},
+            {"pointer_bits", sizeof(void*) * 8}
+        }},
+        {"options", {
+            {"work_directory", m_options.workDirectory.string()},
+            {"max_file_size", m_options.maxFileSize},
+            {"max_store_entries", m_options.maxStoreEntries},
+            {"repetitions", m_options.repetitions}
+        }}
+    };
+
+    std::error_code ec;
+    fs::create_directories(m_scratchDirectory, ec);
+    if (ec) {
+        LOG_ERROR("Failed to create benchmark directory '{}': {}", m_scratchDirectory.string(), ec.message());
+        results["error"] = "cannot create work directory";
+
+        return results;
+    }
+
+    LOG_INFO("Running hashing benchmark in '{}'", m_scratchDirectory.string());
+    {
+        QuietLogging quiet;
+        results["file_hashing"] = RunFileHashing();
+        results["hash_store"] = RunHashStore();
+    }
+
+    fs::remove_all(m_scratchDirectory, ec);
+    if (ec) {
+        LOG_WARN("Failed to remove benchmark directory '{}': {}", m_scratchDirectory.string(), ec.message());
+    }
+
+    results["duration_seconds"] = std::chrono::duration<double>(std::chrono::system_clock::now() - startedAt).count();
+    LOG_INFO("Hashing benchmark finished in {:.1f} s", results["duration_seconds"].get<double>());
+
+    return results;
+}
+
+/**
+ * @brief Measures SHA-256 throughput per file size, read strategy and stride, and the
+ *        `FileHasher` entry points per file size.
+ *
+ * All files are written first and left to age past the window in which `FileHasher`
+ * distrusts snapshots of just-modified files, so the cached lookups hit the cache.
+ */
+json HashBenchmark::RunFileHashing() {
+    json results = json::array();
+    FileHasher hasher((m_scratchDirectory / "file_hashing.hashdb").string());
+
+    std::vector<std::pair<uint64_t, fs::path>> files;
+    for (uint64_t size : FileSizes()) {
+        fs::path file = m_scratchDirectory / ("file_" + std::to_string(size) + ".bin");
+        if (!WriteTestFile(file, size)) {
+            LOG_ERROR("Failed to write benchmark file '{}'", file.string());
+            break;
+        }
+        files.emplace_back(size, std::move(file));
+    }
+    std::this_thread::sleep_for(kSnapshotSettleTime);
+
+    for (const auto& [size, file] : files) {
+        json entry = { {"file_size", size}, {"page_cache", "warm"} };
+
+        json engine = json::array();
+        for (ReadStrategy strategy : kStrategies) {
+            for (size_t stride : kStrides) {
+                ReadOptions options{ strategy, stride };
+                ReadStats stats;
+                double seconds = MedianSeconds([&]() {
+                    return HashEngine::DigestFile(file, EVP_sha256(), options, &stats).has_value();
+                    });
+                engine.push_back({
+                    {"strategy", HashEngine::StrategyName(strategy)},
+                    {"strategy_used", HashEngine::StrategyName(stats.strategy)},
+                    {"stride", stride},
+                    {"median_seconds", seconds},
+                    {"throughput_mbps", ThroughputMBps(size, seconds)}
+                    });
+            }
+        }
+        entry["sha256_engine"] = std::move(engine);
+
+        double full = MedianSeconds([&]() { return hasher.GetFileSHA256(file, true).has_value(); });
+        double cached = MedianSeconds([&]() { return hasher.GetFileSHA256(file).has_value(); });
+        double quick = MedianSeconds([&]() { return hasher.GetFileQuickHash(file, true).has_value(); });
+        entry["get_file_sha256"] = { {"median_seconds", full}, {"throughput_mbps", ThroughputMBps(size, full)} };
+        entry["get_file_sha256_cached"] = { {"median_seconds", cached} };
+        entry["get_file_quick_hash"] = { {"median_seconds", quick}, {"throughput_mbps", ThroughputMBps(size, quick)} };
+
+        results.push_back(std::move(entry));
+
+        std::error_code ec;
+        fs::remove(file, ec);
+    }
+    return results;
+}
+
+/**
+ * @brief Grows a hash store to `maxStoreEntries` and measures it at every checkpoint size.
+ *
+ * Store latencies include the journal appends and compactions the store triggers on its own
+ * while it grows, which is why percentiles are reported next to the mean.
+ */
+json HashBenchmark::RunHashStore() {
+    json results = json::array();
+    const std::string storePath = (m_scratchDirectory / "hash_store.hashdb").string();
+    FileHasher hasher(storePath);
+    std::shared_ptr<HashStore> store = HashStore::Open(storePath);
+
+    std::mt19937_64 random(42);
+    std::vector<std::string> paths;
+    paths.reserve(m_options.maxStoreEntries);
+
+    for (size_t checkpoint : kStoreCheckpoints) {
+        const size_t target = std::min(checkpoint, m_options.maxStoreEntries);
+        if (target <= paths.size()) {
+            break;
+        }
+
+        std::vector<double> storeLatencies;
+        storeLatencies.reserve(target - paths.size());
+        while (paths.size() < target) {
+            paths.push_back("C:\\Benchmark\\Files\\file_" + std::to_string(paths.size()) + ".bin");
+            const std::string hash = RandomHexDigest(random);
+
+            auto start = Clock::now();
+            hasher.StoreFileHash(paths.back(), hash);
+            storeLatencies.push_back(MicrosecondsSince(start));
+        }
+
+        auto flushStart = Clock::now();
+        hasher.Flush();
+        const double flushSeconds = SecondsSince(flushStart);
+
+        std::vector<double> lookupLatencies;
+        lookupLatencies.reserve(kLookupsPerCheckpoint);
+        std::uniform_int_distribution<size_t> pick(0, paths.size() - 1);
+        for (size_t i = 0; i < kLookupsPerCheckpoint; ++i) {
+            const std::string& path = paths[pick(random)];
+            auto start = Clock::now();
+            auto hash = hasher.GetStoredFileHash(path);
+            lookupLatencies.push_back(MicrosecondsSince(start));
+            if (!hash) {
+                LOG_WARN("Benchmark lookup of '{}' found no hash", path);
+            }
+        }
+
+        auto compactStart = Clock::now();
+        const bool compacted = store->Compact();
+        const double compactSeconds = SecondsSince(compactStart);
+
+        std::vector<double> compactedLookupLatencies;
+        compactedLookupLatencies.reserve(kLookupsPerCheckpoint);
+        for (size_t i = 0; i < kLookupsPerCheckpoint; ++i) {
+            const std::string& path = paths[pick(random)];
+            auto start = Clock::now();
+            (void)hasher.GetStoredFileHash(path);
+            compactedLookupLatencies.push_back(MicrosecondsSince(start));
+        }
+
+        std::error_code ec;
+        const uintmax_t imageSize = fs::file_size(store->GetPath(), ec);
+
+        results.push_back({
+            {"entries", paths.size()},
+            {"store_file_hash_us", DescribeDurations(std::move(storeLatencies))},
+            {"flush_seconds", flushSeconds},
+            {"get_stored_file_hash_us", DescribeDurations(std::move(lookupLatencies))},
+            {"compact_seconds", compacted ? compactSeconds : -1.0},
+            {"get_stored_file_hash_after_compact_us", DescribeDurations(std::move(compactedLookupLatencies))},
+            {"image_bytes", ec ? 0 : imageSize}
+            });
+    }
+    return results;
+}
+
+/**
+ * @brief Returns the test file sizes: 4 KiB growing by `kFileSizeFactor` up to `maxFileSize`.
+ */
+std::vector<uint64_t> HashBenchmark::FileSizes() const {
+    std::vector<uint64_t> sizes;
+    for (uint64_t size = kSmallestFileSize; size <= m_options.maxFileSize; size *= kFileSizeFactor) {
+        sizes.push_back(size);
+        if (size > UINT64_MAX / kFileSizeFactor) {
+            break;
+        }
+    }
+    if (!sizes.empty() && sizes.back() < m_options.maxFileSize) {
+        sizes.push_back(m_options.maxFileSize);
+    }
+    return sizes;
+}
+
+/**
+ * @brief Writes a file of pseudo-random, incompressible content.
+ */
+bool HashBenchmark::WriteTestFile(const fs::path& path, uint64_t size) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    std::mt19937_64 random(size);
+    std::vector<uint64_t> buffer(1024 * 1024 / sizeof(uint64_t));
+    uint64_t remaining = size;
+    while (remaining > 0 && out) {
+        for (auto& word : buffer) {
+            word = random();
+        }
+        const size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size() * sizeof(uint64_t)));
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(chunk));
+        remaining -= chunk;
+    }
+    return static_cast<bool>(out);
+}
+
+template <typename Task>
+double HashBenchmark::MedianSeconds(Task&& task) const {
+    std::vector<double> durations;
+    durations.reserve(static_cast<size_t>(m_options.repetitions));
+    for (int i = 0; i < m_options.repetitions; ++i) {
+        auto start = Clock::now();
+        if (!task()) {
+            return -1.0;
+        }
+        durations.push_back(SecondsSince(start));
+    }
+    std::sort(durations.begin(), durations.end());
+    return durations[durations.size() / 2];
+}
+
+/**
+ * @brief Summarizes a set of latencies as mean, median, 99th percentile and maximum.
+ */
+json HashBenchmark::DescribeDurations(std::vector<double> microseconds) {
+    if (microseconds.empty()) {
+        return json::object();
+    }
+
+    std::sort(microseconds.begin(), microseconds.end());
+    double sum = 0.0;
+    for (double value : microseconds) {
+        sum += value;
+    }
+    auto percentile = [&](double p) {
+        return microseconds[std::min(microseconds.size() - 1, static_cast<size_t>(p * microseconds.size()))];
+    };
+
+    return {
+        {"count", microseconds.size()},
+        {"mean", sum / microseconds.size()},
+        {"p50", percentile(0.50)},
+        {"p99", percentile(0.99)},
+        {"max", microseconds.back()}
+    };
+}
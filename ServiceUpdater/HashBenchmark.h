@@ -0,0 +1,70 @@
+#ifndef HASHBENCHMARK_H
+#define HASHBENCHMARK_H
+
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Logger.h"
+#include "HashEngine.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Parameters of a `HashBenchmark` run.
+ */
+struct HashBenchmarkOptions {
+    fs::path workDirectory;                       ///< Directory in which the scratch files are created.
+    uint64_t maxFileSize = 2ull * 1024 * 1024 * 1024;  ///< Largest test file; sizes grow from 4 KiB by a factor of 16.
+    size_t maxStoreEntries = 10000;               ///< Number of entries the hash store is grown to.
+    int repetitions = 3;                          ///< Timed runs per measurement; the median is reported.
+};
+
+/**
+ * @class HashBenchmark
+ * @brief Measures the hashing code paths of the updater and reports the results as JSON.
+ *
+ * Two groups of measurements are taken:
+ * - File hashing: `HashEngine` SHA-256 throughput for every combination of file size, read
+ *   strategy and stride, plus `FileHasher::GetFileSHA256()` (full and cached) and
+ *   `FileHasher::GetFileQuickHash()` per file size.
+ * - Hash store: `StoreFileHash()` and `GetStoredFileHash()` latencies, flush and compaction
+ *   times as the store grows to `maxStoreEntries`.
+ *
+ * Test files are written just before they are hashed, so file hashing is measured with a
+ * warm page cache. All scratch files live in a fresh subdirectory of the work directory,
+ * which is removed afterwards. Informational logging is suppressed while measuring.
+ */
+class HashBenchmark {
+public:
+    explicit HashBenchmark(HashBenchmarkOptions options);
+
+    /**
+     * @brief Runs all measurements.
+     * @return The results; see the class description for the groups it contains.
+     */
+    json Run();
+
+private:
+    HashBenchmarkOptions m_options;
+    fs::path m_scratchDirectory;
+
+    json RunFileHashing();
+    json RunHashStore();
+
+    std::vector<uint64_t> FileSizes() const;
+    bool WriteTestFile(const fs::path& path, uint64_t size) const;
+
+    /**
+     * @brief Runs `task` `m_options.repetitions` times and returns the median duration in seconds.
+     * @return The median, or a negative value if any run failed.
+     */
+    template <typename Task>
+    double MedianSeconds(Task&& task) const;
+
+    static json DescribeDurations(std::vector<double> microseconds);
+};
+
+#endif // HASHBENCHMARK_H
@@ -0,0 +1,789 @@
+#include "HashEngine.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <aio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    struct EvpMdCtxDeleter {
+        void operator()(EVP_MD_CTX* ctx) const {
+            EVP_MD_CTX_free(ctx);
+        }
+    };
+
+    struct AlignedDeleter {
+        std::align_val_t alignment;
+        void operator()(unsigned char* p) const {
+            ::operator delete(p, alignment);
+        }
+    };
+
+    using AlignedBuffer = std::unique_ptr<unsigned char, AlignedDeleter>;
+
+    AlignedBuffer AllocateAligned(size_t size, size_t alignment) {
+        std::align_val_t align{ alignment };
+        return AlignedBuffer(static_cast<unsigned char*>(::operator new(size, align)), AlignedDeleter{ align });
+    }
+
+    /**
+     * @brief Hands a contiguous region to the consumer in strides.
+     */
+    bool FeedStrides(const unsigned char* data, uint64_t size, size_t strideSize, const HashEngine::ChunkConsumer& consumer) {
+        uint64_t offset = 0;
+        while (offset < size) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(strideSize, size - offset));
+            if (!consumer(data + offset, chunk)) {
+                return false;
+            }
+            offset += chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the end of `[offset, offset + length)` clipped to the file size.
+     */
+    uint64_t RangeEnd(uint64_t fileSize, uint64_t offset, uint64_t length) {
+        if (offset >= fileSize) {
+            return offset;
+        }
+        return length >= fileSize - offset ? fileSize : offset + length;
+    }
+
+#ifdef _WIN32
+    struct HandleCloser {
+        void operator()(HANDLE h) const {
+            if (h && h != INVALID_HANDLE_VALUE) {
+                CloseHandle(h);
+            }
+        }
+    };
+
+    using UniqueHandle = std::unique_ptr<void, HandleCloser>;
+#endif
+
+    /**
+     * @brief A file opened for asynchronous reads into a fixed number of slots.
+     *
+     * Each slot holds at most one outstanding read. Reads that are still in flight when the
+     * object is destroyed are cancelled and waited for, so their buffers can be released
+     * right afterwards.
+     */
+    class AsyncFile {
+    public:
+        explicit AsyncFile(size_t slots) : m_slots(slots) {}
+        AsyncFile(const AsyncFile&) = delete;
+        AsyncFile& operator=(const AsyncFile&) = delete;
+
+#ifdef _WIN32
+        ~AsyncFile() {
+            for (Slot& slot : m_slots) {
+                if (slot.pending) {
+                    DWORD ignored = 0;
+                    CancelIoEx(m_file.get(), &slot.overlapped);
+                    GetOverlappedResult(m_file.get(), &slot.overlapped, &ignored, TRUE);
+                }
+            }
+        }
+
+        bool Open(const fs::path& filePath, uint64_t& size) {
+            m_file.reset(CreateFileW(filePath.c_str(), GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+            if (m_file.get() == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            LARGE_INTEGER fileSize{};
+            if (!GetFileSizeEx(m_file.get(), &fileSize)) {
+                return false;
+            }
+            for (Slot& slot : m_slots) {
+                slot.event.reset(CreateEventW(nullptr, TRUE, FALSE, nullptr));
+                if (!slot.event) {
+                    return false;
+                }
+            }
+            size = static_cast<uint64_t>(fileSize.QuadPart);
+            return true;
+        }
+
+        bool Issue(size_t index, unsigned char* buffer, uint64_t offset, size_t size) {
+            Slot& slot = m_slots[index];
+            slot.overlapped = OVERLAPPED{};
+            slot.overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+            slot.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            slot.overlapped.hEvent = slot.event.get();
+            if (!ReadFile(m_file.get(), buffer, static_cast<DWORD>(size), nullptr, &slot.overlapped) &&
+                GetLastError() != ERROR_IO_PENDING) {
+                m_error = static_cast<int>(GetLastError());
+                return false;
+            }
+            slot.pending = true;
+            return true;
+        }
+
+        /// Waits for the read of a slot; returns the number of bytes read, or -1 on error.
+        int64_t Wait(size_t index) {
+            Slot& slot = m_slots[index];
+            DWORD read = 0;
+            BOOL ok = GetOverlappedResult(m_file.get(), &slot.overlapped, &read, TRUE);
+            slot.pending = false;
+            if (!ok) {
+                DWORD error = GetLastError();
+                if (error == ERROR_HANDLE_EOF) {
+                    return 0;
+                }
+                m_error = static_cast<int>(error);
+                return -1;
+            }
+            return read;
+        }
+#else
+        ~AsyncFile() {
+            for (Slot& slot : m_slots) {
+                if (slot.pending) {
+                    aio_cancel(m_fd, &slot.cb);
+                    Drain(slot);
+                }
+            }
+            if (m_fd >= 0) {
+                close(m_fd);
+            }
+        }
+
+        bool Open(const fs::path& filePath, uint64_t& size) {
+            m_fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (m_fd < 0) {
+                return false;
+            }
+
+            struct stat st {};
+            if (fstat(m_fd, &st) != 0) {
+                return false;
+            }
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            size = static_cast<uint64_t>(st.st_size);
+            return true;
+        }
+
+        bool Issue(size_t index, unsigned char* buffer, uint64_t offset, size_t size) {
+            Slot& slot = m_slots[index];
+            slot.cb = aiocb{};
+            slot.cb.aio_fildes = m_fd;
+            slot.cb.aio_offset = static_cast<off_t>(offset);
+            slot.cb.aio_buf = buffer;
+            slot.cb.aio_nbytes = size;
+            slot.cb.aio_sigevent.sigev_notify = SIGEV_NONE;
+            if (aio_read(&slot.cb) != 0) {
+                m_error = errno;
+                return false;
+            }
+            slot.pending = true;
+            return true;
+        }
+
+        /// Waits for the read of a slot; returns the number of bytes read, or -1 on error.
+        int64_t Wait(size_t index) {
+            ssize_t read = Drain(m_slots[index]);
+            return read < 0 ? -1 : read;
+        }
+#endif
+
+        [[nodiscard]] int Error() const { return m_error; }
+
+    private:
+#ifdef _WIN32
+        struct Slot {
+            OVERLAPPED overlapped{};
+            UniqueHandle event;
+            bool pending = false;
+        };
+
+        UniqueHandle m_file;
+#else
+        struct Slot {
+            aiocb cb{};
+            bool pending = false;
+        };
+
+        ssize_t Drain(Slot& slot) {
+            const aiocb* list[] = { &slot.cb };
+            while (aio_error(&slot.cb) == EINPROGRESS) {
+                aio_suspend(list, 1, nullptr);
+            }
+            slot.pending = false;
+            int error = aio_error(&slot.cb);
+            ssize_t read = aio_return(&slot.cb);
+            if (read < 0) {
+                m_error = error;
+            }
+            return read;
+        }
+
+        int m_fd = -1;
+#endif
+        std::vector<Slot> m_slots;
+        int m_error = 0;
+    };
+}
+
+/**
+ * @brief Delivers the whole content of a file to a consumer using the requested strategy.
+ *
+ * @param filePath The file to read.
+ * @param consumer Callback invoked for every chunk.
+ * @param options Read strategy and stride size.
+ * @param stats Optional output for byte count, duration and the strategy used.
+ * @return true if the whole file was delivered, false otherwise.
+ */
+bool HashEngine::ForEachChunk(const fs::path& filePath, const ChunkConsumer& consumer,
+    const ReadOptions& options, ReadStats* stats) {
+    return ForEachChunkInRange(filePath, 0, kToEnd, consumer, options, stats);
+}
+
+/**
+ * @brief Delivers a byte range of a file to a consumer using the requested strategy.
+ *
+ * With `ReadStrategy::Auto` the file is memory-mapped; if the file cannot be mapped (for
+ * example on some network redirectors) it is read through the buffered path instead.
+ * `ReadStrategy::Pipelined` likewise falls back to the buffered path where asynchronous
+ * reads are not supported.
+ * A range extending past the end of the file is clipped; `stats->bytes` tells how much
+ * was actually delivered.
+ *
+ * @param filePath The file to read.
+ * @param offset Position of the first byte to deliver.
+ * @param length Number of bytes to deliver, or `kToEnd` for the rest of the file.
+ * @param consumer Callback invoked for every chunk.
+ * @param options Read strategy and stride size.
+ * @param stats Optional output for byte count, duration and the strategy used.
+ * @return true if the range was delivered, false otherwise.
+ */
+bool HashEngine::ForEachChunkInRange(const fs::path& filePath, uint64_t offset, uint64_t length,
+    const ChunkConsumer& consumer, const ReadOptions& options, ReadStats* stats) {
+    const size_t strideSize = std::max<size_t>(options.strideSize, kBufferAlignment);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+
+    ReadStrategy used = options.strategy;
+    PassResult result = PassResult::Unavailable;
+
+    if (options.strategy == ReadStrategy::Auto || options.strategy == ReadStrategy::MemoryMapped) {
+        used = ReadStrategy::MemoryMapped;
+        result = ReadMapped(filePath, offset, length, consumer, strideSize, bytes);
+    }
+
+    if (options.strategy == ReadStrategy::Pipelined) {
+        used = ReadStrategy::Pipelined;
+        result = ReadPipelined(filePath, offset, length, consumer, strideSize, bytes);
+    }
+
+    if (result == PassResult::Unavailable && options.strategy != ReadStrategy::MemoryMapped) {
+        used = ReadStrategy::BufferedRead;
+        result = ReadBuffered(filePath, offset, length, consumer, strideSize, bytes);
+    }
+
+    if (stats) {
+        stats->bytes = bytes;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->strategy = used;
+    }
+
+    if (result == PassResult::Unavailable) {
+        LOG_ERROR("Failed to open file for reading: {}", filePath.string());
+    }
+
+    return result == PassResult::Ok;
+}
+
+/**
+ * @brief Computes the digest of a file and logs the throughput that was achieved.
+ *
+ * @param filePath The file to hash.
+ * @param md The digest algorithm, e.g. `EVP_sha256()`.
+ * @param options Read strategy and stride size.
+ * @param stats Optional output for byte count, duration and the strategy used.
+ * @return The hex encoded digest, or `std::nullopt` on failure.
+ */
+std::optional<std::string> HashEngine::DigestFile(const fs::path& filePath, const EVP_MD* md,
+    const ReadOptions& options, ReadStats* stats) {
+    std::unique_ptr<EVP_MD_CTX, EvpMdCtxDeleter> mdctx(EVP_MD_CTX_new());
+    if (!mdctx) {
+        LOG_ERROR("Failed to create EVP_MD_CTX for hashing.");
+
+        return std::nullopt;
+    }
+
+    if (EVP_DigestInit_ex(mdctx.get(), md, nullptr) != 1) {
+        LOG_ERROR("Failed to initialize {} context.", EVP_MD_get0_name(md));
+
+        return std::nullopt;
+    }
+
+    ReadStats localStats;
+    bool updateFailed = false;
+    bool ok = ForEachChunk(filePath, [&](const unsigned char* data, size_t size) {
+        if (EVP_DigestUpdate(mdctx.get(), data, size) != 1) {
+            updateFailed = true;
+            return false;
+        }
+        return true;
+        }, options, &localStats);
+
+    if (stats) {
+        *stats = localStats;
+    }
+
+    if (!ok) {
+        if (updateFailed) {
+            LOG_ERROR("Failed to update {} digest.", EVP_MD_get0_name(md));
+        }
+        else {
+            LOG_ERROR("Failed to read file for {} calculation: {}", EVP_MD_get0_name(md), filePath.string());
+        }
+
+        return std::nullopt;
+    }
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int lengthOfHash = 0;
+    if (EVP_DigestFinal_ex(mdctx.get(), hash, &lengthOfHash) != 1) {
+        LOG_ERROR("Failed to finalize {} digest.", EVP_MD_get0_name(md));
+
+        return std::nullopt;
+    }
+
+    LOG_INFO("Hashed '{}' ({} bytes) in {:.1f} ms, {:.1f} MB/s ({}).", filePath.string(), localStats.bytes,
+        localStats.seconds * 1000.0, localStats.ThroughputMBps(), StrategyName(localStats.strategy));
+
+    return ToHex(hash, lengthOfHash);
+}
+
+std::optional<std::string> HashEngine::DigestBuffer(const void* data, size_t size, const EVP_MD* md) {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int lengthOfHash = 0;
+    if (EVP_Digest(data, size, hash, &lengthOfHash, md, nullptr) != 1) {
+        LOG_ERROR("Failed to compute {} digest of {} bytes.", EVP_MD_get0_name(md), size);
+
+        return std::nullopt;
+    }
+    return ToHex(hash, lengthOfHash);
+}
+
+/**
+ * @brief Computes the binary digest of a byte range of a file, optionally preceded by a prefix.
+ *
+ * Used for the blocks of a Merkle tree, where many ranges are hashed concurrently and
+ * logging every one of them would only add noise; only failures are logged.
+ *
+ * @param filePath The file to hash.
+ * @param offset Position of the first byte of the range.
+ * @param length Number of bytes in the range; the range must lie within the file.
+ * @param md The digest algorithm, e.g. `EVP_sha256()`.
+ * @param prefix Bytes hashed before the file content (for domain separation).
+ * @param options Read strategy and stride size.
+ * @return The raw digest, or `std::nullopt` on failure or if the file is shorter than the range.
+ */
+std::optional<std::vector<unsigned char>> HashEngine::DigestRange(const fs::path& filePath, uint64_t offset,
+    uint64_t length, const EVP_MD* md, std::string_view prefix, const ReadOptions& options) {
+    std::unique_ptr<EVP_MD_CTX, EvpMdCtxDeleter> mdctx(EVP_MD_CTX_new());
+    if (!mdctx || EVP_DigestInit_ex(mdctx.get(), md, nullptr) != 1 ||
+        EVP_DigestUpdate(mdctx.get(), prefix.data(), prefix.size()) != 1) {
+        LOG_ERROR("Failed to initialize {} context.", EVP_MD_get0_name(md));
+
+        return std::nullopt;
+    }
+
+    ReadStats stats;
+    bool ok = ForEachChunkInRange(filePath, offset, length, [&](const unsigned char* data, size_t size) {
+        return EVP_DigestUpdate(mdctx.get(), data, size) == 1;
+        }, options, &stats);
+
+    if (!ok || stats.bytes != length) {
+        LOG_ERROR("Failed to hash bytes {}-{} of '{}' ({} of {} bytes read).",
+            offset, offset + length, filePath.string(), stats.bytes, length);
+
+        return std::nullopt;
+    }
+
+    std::vector<unsigned char> digest(EVP_MD_get_size(md));
+    unsigned int lengthOfHash = 0;
+    if (EVP_DigestFinal_ex(mdctx.get(), digest.data(), &lengthOfHash) != 1) {
+        LOG_ERROR("Failed to finalize {} digest.", EVP_MD_get0_name(md));
+
+        return std::nullopt;
+    }
+    digest.resize(lengthOfHash);
+    return digest;
+}
+
+DigestStream::DigestStream(const EVP_MD* md) : m_md(md), m_context(EVP_MD_CTX_new()) {
+    Reset();
+}
+
+DigestStream::~DigestStream() {
+    EVP_MD_CTX_free(m_context);
+}
+
+void DigestStream::Reset() {
+    m_bytes = 0;
+    m_failed = !m_context || EVP_DigestInit_ex(m_context, m_md, nullptr) != 1;
+    if (m_failed) {
+        LOG_ERROR("Failed to initialize {} context.", EVP_MD_get0_name(m_md));
+    }
+}
+
+void DigestStream::Update(const void* data, size_t size) {
+    if (m_failed) {
+        return;
+    }
+    if (EVP_DigestUpdate(m_context, data, size) != 1) {
+        LOG_ERROR("Failed to update {} digest.", EVP_MD_get0_name(m_md));
+
+        m_failed = true;
+        return;
+    }
+    m_bytes += size;
+}
+
+bool DigestStream::UpdateFromFile(const fs::path& filePath, uint64_t offset, uint64_t length) {
+    if (m_failed) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    const uint64_t before = m_bytes;
+    // Buffered reads share the file with the handles still writing to it
+    ReadOptions options;
+    options.strategy = ReadStrategy::BufferedRead;
+    bool read = HashEngine::ForEachChunkInRange(filePath, offset, length, [this](const unsigned char* data, size_t size) {
+        Update(data, size);
+        return !m_failed;
+    }, options);
+    if (!read || m_bytes - before != length) {
+        LOG_ERROR("Failed to read bytes {}-{} of {} for the {} digest.", offset, offset + length, filePath.string(), EVP_MD_get0_name(m_md));
+
+        m_failed = true;
+    }
+    return !m_failed;
+}
+
+std::optional<std::string> DigestStream::Finish() {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int lengthOfHash = 0;
+    if (m_failed || EVP_DigestFinal_ex(m_context, hash, &lengthOfHash) != 1) {
+        m_failed = true;
+        return std::nullopt;
+    }
+    m_failed = true;
+    return HashEngine::ToHex(hash, lengthOfHash);
+}
+
+std::string HashEngine::ToHex(const unsigned char* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        hex[2 * i] = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+std::optional<std::string> HashEngine::Base64ToHex(std::string_view base64) {
+    if (base64.empty() || base64.size() % 4 != 0) {
+        return std::nullopt;
+    }
+
+    std::vector<unsigned char> decoded(base64.size() / 4 * 3);
+    int length = EVP_DecodeBlock(decoded.data(), reinterpret_cast<const unsigned char*>(base64.data()),
+        static_cast<int>(base64.size()));
+    if (length < 0) {
+        return std::nullopt;
+    }
+    // EVP_DecodeBlock() counts the padding as decoded zero bytes
+    size_t size = static_cast<size_t>(length);
+    for (size_t i = base64.size(); i > 0 && base64[i - 1] == '='; --i) {
+        --size;
+    }
+    return ToHex(decoded.data(), size);
+}
+
+const char* HashEngine::StrategyName(ReadStrategy strategy) {
+    switch (strategy) {
+    case ReadStrategy::MemoryMapped:
+        return "mmap";
+    case ReadStrategy::BufferedRead:
+        return "buffered";
+    case ReadStrategy::Pipelined:
+        return "pipelined";
+    default:
+        return "auto";
+    }
+}
+
+/**
+ * @brief Reads a byte range of a file through successive read-only views of a file mapping.
+ *
+ * On Windows the file is opened with `FILE_FLAG_SEQUENTIAL_SCAN` and without write sharing,
+ * so it cannot be truncated underneath the mapping. On POSIX systems each view is advised
+ * with `MADV_SEQUENTIAL`. Views start on a `kViewAlignment` boundary, so a range starting
+ * anywhere in the file can be mapped.
+ */
+HashEngine::PassResult HashEngine::ReadMapped(const fs::path& filePath, uint64_t offset, uint64_t length,
+    const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes) {
+#ifdef _WIN32
+    UniqueHandle file(CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (file.get() == INVALID_HANDLE_VALUE) {
+        return PassResult::Unavailable;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file.get(), &fileSize)) {
+        return PassResult::Unavailable;
+    }
+
+    const uint64_t size = static_cast<uint64_t>(fileSize.QuadPart);
+    const uint64_t end = RangeEnd(size, offset, length);
+    if (offset >= end) {
+        return PassResult::Ok;
+    }
+
+    UniqueHandle mapping(CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!mapping) {
+        return PassResult::Unavailable;
+    }
+
+    for (uint64_t position = offset; position < end;) {
+        const uint64_t viewStart = position - position % kViewAlignment;
+        const uint64_t viewSize = std::min(kMapViewSize, end - viewStart);
+        void* view = MapViewOfFile(mapping.get(), FILE_MAP_READ,
+            static_cast<DWORD>(viewStart >> 32), static_cast<DWORD>(viewStart & 0xFFFFFFFF), static_cast<SIZE_T>(viewSize));
+        if (!view) {
+            return position == offset ? PassResult::Unavailable : PassResult::Failed;
+        }
+
+        const uint64_t skip = position - viewStart;
+        bool ok = FeedStrides(static_cast<const unsigned char*>(view) + skip, viewSize - skip, strideSize, consumer);
+        UnmapViewOfFile(view);
+        if (!ok) {
+            return PassResult::Failed;
+        }
+        bytes += viewSize - skip;
+        position = viewStart + viewSize;
+    }
+
+    return PassResult::Ok;
+#else
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return PassResult::Unavailable;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return PassResult::Unavailable;
+    }
+
+    const uint64_t end = RangeEnd(static_cast<uint64_t>(st.st_size), offset, length);
+    PassResult result = PassResult::Ok;
+
+    for (uint64_t position = offset; position < end;) {
+        const uint64_t viewStart = position - position % kViewAlignment;
+        const uint64_t viewSize = std::min(kMapViewSize, end - viewStart);
+        void* view = mmap(nullptr, static_cast<size_t>(viewSize), PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(viewStart));
+        if (view == MAP_FAILED) {
+            result = position == offset ? PassResult::Unavailable : PassResult::Failed;
+            break;
+        }
+
+        posix_madvise(view, static_cast<size_t>(viewSize), POSIX_MADV_SEQUENTIAL);
+        const uint64_t skip = position - viewStart;
+        bool ok = FeedStrides(static_cast<const unsigned char*>(view) + skip, viewSize - skip, strideSize, consumer);
+        munmap(view, static_cast<size_t>(viewSize));
+        if (!ok) {
+            result = PassResult::Failed;
+            break;
+        }
+        bytes += viewSize - skip;
+        position = viewStart + viewSize;
+    }
+
+    close(fd);
+    return result;
+#endif
+}
+
+/**
+ * @brief Reads a byte range of a file sequentially into a page-aligned buffer of `strideSize` bytes.
+ *
+ * Unlike the mapped path, the file is opened with full sharing so that it can still be read
+ * while another process holds it open for writing.
+ */
+HashEngine::PassResult HashEngine::ReadBuffered(const fs::path& filePath, uint64_t offset, uint64_t length,
+    const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes) {
+    const size_t bufferSize = (strideSize + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+
+#ifdef _WIN32
+    UniqueHandle file(CreateFileW(filePath.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (file.get() == INVALID_HANDLE_VALUE) {
+        return PassResult::Unavailable;
+    }
+
+    LARGE_INTEGER start{};
+    start.QuadPart = static_cast<LONGLONG>(offset);
+    if (offset != 0 && !SetFilePointerEx(file.get(), start, nullptr, FILE_BEGIN)) {
+        return PassResult::Unavailable;
+    }
+
+    AlignedBuffer buffer = AllocateAligned(bufferSize, kBufferAlignment);
+    uint64_t remaining = length;
+    while (remaining > 0) {
+        DWORD toRead = static_cast<DWORD>(std::min<uint64_t>(bufferSize, remaining));
+        DWORD read = 0;
+        if (!ReadFile(file.get(), buffer.get(), toRead, &read, nullptr)) {
+            LOG_ERROR("ReadFile failed for '{}'. Error code: {}", filePath.string(), GetLastError());
+            return PassResult::Failed;
+        }
+        if (read == 0) {
+            break;
+        }
+        if (!consumer(buffer.get(), read)) {
+            return PassResult::Failed;
+        }
+        bytes += read;
+        remaining -= read;
+    }
+    return PassResult::Ok;
+#else
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return PassResult::Unavailable;
+    }
+
+    posix_fadvise(fd, static_cast<off_t>(offset), length == kToEnd ? 0 : static_cast<off_t>(length), POSIX_FADV_SEQUENTIAL);
+    AlignedBuffer buffer = AllocateAligned(bufferSize, kBufferAlignment);
+    PassResult result = PassResult::Ok;
+    uint64_t position = offset;
+    uint64_t remaining = length;
+
+    while (remaining > 0) {
+        size_t toRead = static_cast<size_t>(std::min<uint64_t>(bufferSize, remaining));
+        ssize_t n = pread(fd, buffer.get(), toRead, static_cast<off_t>(position));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("read failed for '{}': {}", filePath.string(), errno);
+            result = PassResult::Failed;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (!consumer(buffer.get(), static_cast<size_t>(n))) {
+            result = PassResult::Failed;
+            break;
+        }
+        bytes += static_cast<uint64_t>(n);
+        position += static_cast<uint64_t>(n);
+        remaining -= static_cast<uint64_t>(n);
+    }
+
+    close(fd);
+    return result;
+#endif
+}
+
+/**
+ * @brief Reads a byte range of a file with up to `kPipelineDepth` asynchronous reads in flight.
+ *
+ * The range is split into strides that are read into page-aligned buffers, one per slot.
+ * Stride `k` always uses slot `k % kPipelineDepth`; once its read completes and the consumer
+ * has processed it, the slot is reused for the next stride that has not been requested yet.
+ * Strides are therefore delivered in order while the following ones are still being read.
+ * If the file shrinks during the pass, the pass ends after the last stride that was read.
+ */
+HashEngine::PassResult HashEngine::ReadPipelined(const fs::path& filePath, uint64_t offset, uint64_t length,
+    const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes) {
+    const size_t bufferSize = (strideSize + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+
+    AsyncFile file(kPipelineDepth);
+    uint64_t size = 0;
+    if (!file.Open(filePath, size)) {
+        return PassResult::Unavailable;
+    }
+
+    const uint64_t end = RangeEnd(size, offset, length);
+    const size_t strideCount = static_cast<size_t>(std::min<uint64_t>(kPipelineDepth,
+        (end - std::min(offset, end) + bufferSize - 1) / bufferSize));
+    std::vector<AlignedBuffer> buffers;
+    for (size_t i = 0; i < strideCount; ++i) {
+        buffers.push_back(AllocateAligned(bufferSize, kBufferAlignment));
+    }
+    size_t requested[kPipelineDepth] = {};
+
+    uint64_t next = offset;
+    size_t issued = 0;
+    auto issue = [&](size_t slot) {
+        if (next >= end) {
+            return true;
+        }
+        requested[slot] = static_cast<size_t>(std::min<uint64_t>(bufferSize, end - next));
+        if (!file.Issue(slot, buffers[slot].get(), next, requested[slot])) {
+            return false;
+        }
+        next += requested[slot];
+        ++issued;
+        return true;
+        };
+
+    for (size_t slot = 0; slot < strideCount; ++slot) {
+        if (!issue(slot)) {
+            if (issued == 0) {
+                return PassResult::Unavailable;
+            }
+            LOG_ERROR("Asynchronous read failed for '{}'. Error code: {}", filePath.string(), file.Error());
+            return PassResult::Failed;
+        }
+    }
+
+    for (size_t completed = 0; completed < issued; ++completed) {
+        const size_t slot = completed % kPipelineDepth;
+        int64_t read = file.Wait(slot);
+        if (read < 0) {
+            LOG_ERROR("Asynchronous read failed for '{}'. Error code: {}", filePath.string(), file.Error());
+            return PassResult::Failed;
+        }
+        if (read > 0 && !consumer(buffers[slot].get(), static_cast<size_t>(read))) {
+            return PassResult::Failed;
+        }
+        bytes += static_cast<uint64_t>(read);
+        if (static_cast<size_t>(read) < requested[slot]) {
+            break;
+        }
+        if (!issue(slot)) {
+            LOG_ERROR("Asynchronous read failed for '{}'. Error code: {}", filePath.string(), file.Error());
+            return PassResult::Failed;
+        }
+    }
+
+    return PassResult::Ok;
+}
@@ -0,0 +1,206 @@
+#ifndef HASHENGINE_H
+#define HASHENGINE_H
+
+#include <openssl/evp.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <cstdint>
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief How `HashEngine` reads file content.
+ */
+enum class ReadStrategy {
+    Auto,          ///< Memory-map the file, falling back to buffered reads if mapping fails.
+    MemoryMapped,  ///< Map the file in large views with sequential-access advice.
+    BufferedRead,  ///< Read the file into a large, page-aligned buffer.
+    Pipelined      ///< Keep several asynchronous reads in flight, falling back to buffered reads.
+};
+
+/**
+ * @brief Parameters of one pass over a file.
+ */
+struct ReadOptions {
+    ReadStrategy strategy = ReadStrategy::Auto;  ///< How the file is read.
+    size_t strideSize = 4 * 1024 * 1024;         ///< Size of the chunks handed to the consumer.
+};
+
+/**
+ * @brief Statistics about one pass over a file.
+ */
+struct ReadStats {
+    uint64_t bytes = 0;                          ///< Number of bytes delivered to the consumer.
+    double seconds = 0.0;                        ///< Wall-clock duration of the pass.
+    ReadStrategy strategy = ReadStrategy::Auto;  ///< Strategy that was actually used.
+
+    /**
+     * @brief Returns the achieved throughput in MB/s (10^6 bytes per second).
+     */
+    [[nodiscard]] double ThroughputMBps() const {
+        return seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0;
+    }
+};
+
+/**
+ * @class HashEngine
+ * @brief Reads files in large strides and feeds them to digest functions.
+ *
+ * Files are memory-mapped in views of `kMapViewSize` bytes (so large files also work in a
+ * 32-bit process) with sequential-access hints, or read through a page-aligned buffer when
+ * mapping is unavailable. Content is handed to the consumer in strides of `strideSize`
+ * bytes, which keeps the number of digest update calls and system calls low.
+ *
+ * The pipelined strategy keeps `kPipelineDepth` reads of one stride each in flight (overlapped
+ * I/O on Windows, POSIX AIO elsewhere), so the disk keeps working while the consumer digests
+ * the oldest completed stride. This pays off on network-backed and NVMe disks, where a single
+ * outstanding read leaves most of the device idle.
+ */
+class HashEngine {
+public:
+    /// Receives consecutive chunks of the file; return false to abort the pass.
+    using ChunkConsumer = std::function<bool(const unsigned char* data, size_t size)>;
+
+    /// Range length meaning "up to the end of the file".
+    static constexpr uint64_t kToEnd = UINT64_MAX;
+
+    /**
+     * @brief Delivers the whole content of a file to a consumer, chunk by chunk, in order.
+     *
+     * @param filePath The file to read.
+     * @param consumer Callback invoked for every chunk.
+     * @param options Read strategy and stride size.
+     * @param stats Optional output for byte count, duration and the strategy used.
+     * @return true if the whole file was delivered, false on I/O error or if the consumer aborted.
+     */
+    static bool ForEachChunk(const fs::path& filePath, const ChunkConsumer& consumer,
+        const ReadOptions& options = {}, ReadStats* stats = nullptr);
+
+    /**
+     * @brief Delivers the bytes `[offset, offset + length)` of a file to a consumer, in order.
+     *
+     * Ranges of the same file can be read concurrently from several threads.
+     *
+     * @return true if the range (clipped to the file size) was delivered, false on I/O error or abort.
+     */
+    static bool ForEachChunkInRange(const fs::path& filePath, uint64_t offset, uint64_t length,
+        const ChunkConsumer& consumer, const ReadOptions& options = {}, ReadStats* stats = nullptr);
+
+    /**
+     * @brief Computes the digest of a file with the given OpenSSL message digest.
+     *
+     * @param filePath The file to hash.
+     * @param md The digest algorithm, e.g. `EVP_sha256()`.
+     * @param options Read strategy and stride size.
+     * @param stats Optional output for byte count, duration and the strategy used.
+     * @return The hex encoded digest, or `std::nullopt` on failure.
+     */
+    static std::optional<std::string> DigestFile(const fs::path& filePath, const EVP_MD* md,
+        const ReadOptions& options = {}, ReadStats* stats = nullptr);
+
+    /**
+     * @brief Computes the raw digest of `prefix` followed by the bytes `[offset, offset + length)` of a file.
+     *
+     * @return The binary digest, or `std::nullopt` on failure or if the file ends before the range does.
+     */
+    static std::optional<std::vector<unsigned char>> DigestRange(const fs::path& filePath, uint64_t offset,
+        uint64_t length, const EVP_MD* md, std::string_view prefix = {}, const ReadOptions& options = {});
+
+    /**
+     * @brief Computes the digest of a buffer that is already in memory.
+     *
+     * @return The hex encoded digest, or `std::nullopt` on failure.
+     */
+    static std::optional<std::string> DigestBuffer(const void* data, size_t size, const EVP_MD* md);
+
+    /**
+     * @brief Encodes binary data as lowercase hexadecimal.
+     */
+    static std::string ToHex(const unsigned char* data, size_t size);
+
+    /**
+     * @brief Converts a base64 encoded digest (such as a `Content-MD5` header) to lowercase hexadecimal.
+     * @return The hex string, or `std::nullopt` if the input is not valid base64.
+     */
+    static std::optional<std::string> Base64ToHex(std::string_view base64);
+
+    static const char* StrategyName(ReadStrategy strategy);
+
+private:
+    /// Size of one mapped view; a multiple of the allocation granularity on every platform.
+    static constexpr uint64_t kMapViewSize = 64ull * 1024 * 1024;
+    /// Alignment of the start of a mapped view (the Windows allocation granularity).
+    static constexpr uint64_t kViewAlignment = 64 * 1024;
+    /// Alignment of the buffered-read buffer (sector and page aligned).
+    static constexpr size_t kBufferAlignment = 4096;
+    /// Number of reads the pipelined strategy keeps in flight per file.
+    static constexpr size_t kPipelineDepth = 4;
+
+    enum class PassResult {
+        Ok,           ///< The whole file was delivered.
+        Unavailable,  ///< The strategy cannot be used for this file; nothing was delivered.
+        Failed        ///< I/O error or the consumer aborted.
+    };
+
+    static PassResult ReadMapped(const fs::path& filePath, uint64_t offset, uint64_t length,
+        const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes);
+    static PassResult ReadBuffered(const fs::path& filePath, uint64_t offset, uint64_t length,
+        const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes);
+    static PassResult ReadPipelined(const fs::path& filePath, uint64_t offset, uint64_t length,
+        const ChunkConsumer& consumer, size_t strideSize, uint64_t& bytes);
+};
+
+/**
+ * @class DigestStream
+ * @brief Digest computed incrementally over data that arrives in pieces, such as a download.
+ *
+ * Feeding every chunk of a download to the stream as it is written leaves the digest of
+ * the file ready when the transfer completes, without reading the file back. A download
+ * that resumes a partial file first feeds the part already on disk with `UpdateFromFile()`.
+ */
+class DigestStream {
+public:
+    explicit DigestStream(const EVP_MD* md = EVP_sha256());
+    ~DigestStream();
+
+    DigestStream(const DigestStream&) = delete;
+    DigestStream& operator=(const DigestStream&) = delete;
+
+    /**
+     * @brief Starts over with no data hashed.
+     */
+    void Reset();
+
+    /**
+     * @brief Appends data to the digest.
+     */
+    void Update(const void* data, size_t size);
+
+    /**
+     * @brief Appends the bytes `[offset, offset + length)` of a file to the digest.
+     * @return false if the file could not be read; the stream is then failed.
+     */
+    bool UpdateFromFile(const fs::path& filePath, uint64_t offset, uint64_t length);
+
+    /// Number of bytes hashed since the last `Reset()`.
+    [[nodiscard]] uint64_t Bytes() const { return m_bytes; }
+
+    /**
+     * @brief Finalizes the digest; the stream has to be `Reset()` before it is used again.
+     * @return The hex encoded digest, or `std::nullopt` if hashing failed at any point.
+     */
+    std::optional<std::string> Finish();
+
+private:
+    const EVP_MD* m_md;
+    EVP_MD_CTX* m_context = nullptr;
+    uint64_t m_bytes = 0;
+    bool m_failed = false;
+};
+
+#endif // HASHENGINE_H
@@ -0,0 +1,64 @@
+#ifndef HASHRECORD_H
+#define HASHRECORD_H
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <ctime>
+#include <cstdint>
+
+/**
+ * @brief File system metadata that identifies one particular version of a file.
+ *
+ * Times are kept in the platform's native resolution (100 ns FILETIME ticks on Windows,
+ * nanoseconds since the epoch elsewhere) and are only ever compared with each other.
+ */
+struct StatFingerprint {
+    uint64_t size = 0;      ///< File size in bytes.
+    int64_t mtime = 0;      ///< Last write time.
+    int64_t ctime = 0;      ///< Last metadata change time.
+    uint64_t fileId = 0;    ///< File index (Windows) or inode number.
+    uint64_t volumeId = 0;  ///< Volume serial number (Windows) or device number.
+
+    bool operator==(const StatFingerprint& other) const {
+        return size == other.size && mtime == other.mtime && ctime == other.ctime &&
+            fileId == other.fileId && volumeId == other.volumeId;
+    }
+    bool operator!=(const StatFingerprint& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Block-level Merkle tree of a file.
+ *
+ * The file is split into blocks of `blockSize` bytes (the last one may be shorter). Each leaf
+ * is SHA-256(0x00 || block) and each inner node SHA-256(0x01 || left || right); a node
+ * without a sibling is carried up to the next level unchanged.
+ */
+struct MerkleTree {
+    uint64_t blockSize = 0;           ///< Size of every block but the last, in bytes.
+    std::string root;                 ///< Hex encoded root digest.
+    std::vector<std::string> blocks;  ///< Hex encoded leaf digest of every block, in file order.
+};
+
+/**
+ * @brief The digests last computed for a file, together with the metadata they were computed for.
+ */
+struct FileSnapshot {
+    StatFingerprint stat;               ///< Metadata of the file when it was hashed.
+    std::string sha256;                 ///< Hex encoded digest of the file content (empty if not computed).
+    int64_t hashedAt = 0;               ///< Time of hashing, in the same unit as `StatFingerprint` times.
+    std::optional<MerkleTree> merkle;   ///< Block digests of the file content, if computed.
+    std::string quickHash;              ///< Hex encoded BLAKE2b-256 digest of the file content (empty if not computed).
+};
+
+/**
+ * @brief A single entry of the hash store.
+ */
+struct HashRecord {
+    std::string fileHash;                 ///< Hex encoded SHA-256 digest recorded for the file (empty if none).
+    std::time_t timestamp = 0;            ///< Time at which the digest was recorded.
+    std::optional<FileSnapshot> snapshot; ///< Cached digest of the file content as last seen on disk.
+    std::string quickHash;                ///< Hex encoded BLAKE2b-256 digest of the content `fileHash` was computed for (empty if unknown).
+};
+
+#endif // HASHRECORD_H
@@ -0,0 +1,769 @@
+#include "HashStore.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /**
+     * @brief Writes `data` to a file and flushes it to stable storage before returning.
+     *
+     * @param path The file to write.
+     * @param data The bytes to write.
+     * @param append Append to the file (creating it if needed) instead of replacing its content.
+     * @return true if all data reached the disk, false otherwise.
+     */
+    bool WriteDurably(const fs::path& path, const std::string& data, bool append) {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ,
+            nullptr, append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            LOG_ERROR("Failed to open '{}' for writing. Error code: {}", path.string(), GetLastError());
+            return false;
+        }
+
+        size_t written = 0;
+        bool ok = true;
+        while (ok && written < data.size()) {
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size() - written, 1u << 30));
+            DWORD done = 0;
+            ok = WriteFile(file, data.data() + written, chunk, &done, nullptr) && done > 0;
+            written += done;
+        }
+        ok = ok && FlushFileBuffers(file);
+        if (!ok) {
+            LOG_ERROR("Failed to write '{}'. Error code: {}", path.string(), GetLastError());
+        }
+        CloseHandle(file);
+        return ok;
+#else
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0) {
+            LOG_ERROR("Failed to open '{}' for writing: {}", path.string(), errno);
+            return false;
+        }
+
+        size_t written = 0;
+        bool ok = true;
+        while (ok && written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = n > 0;
+            written += ok ? static_cast<size_t>(n) : 0;
+        }
+        ok = ok && fsync(fd) == 0;
+        if (!ok) {
+            LOG_ERROR("Failed to write '{}': {}", path.string(), errno);
+        }
+        close(fd);
+        return ok;
+#endif
+    }
+
+    /**
+     * @brief Atomically replaces `target` with `source`, making the rename itself durable.
+     */
+    bool ReplaceFile(const fs::path& source, const fs::path& target) {
+#ifdef _WIN32
+        if (!MoveFileExW(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            LOG_ERROR("Failed to replace '{}'. Error code: {}", target.string(), GetLastError());
+            return false;
+        }
+        return true;
+#else
+        if (rename(source.c_str(), target.c_str()) != 0) {
+            LOG_ERROR("Failed to replace '{}': {}", target.string(), errno);
+            return false;
+        }
+
+        fs::path directory = target.has_parent_path() ? target.parent_path() : fs::path(".");
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+        return true;
+#endif
+    }
+}
+
+std::mutex HashStore::s_registryMutex;
+std::unordered_map<std::string, std::shared_ptr<HashStore>> HashStore::s_registry;
+
+/**
+ * @brief Returns the shared store for a hash store file.
+ *
+ * Stores are registered by the absolute, lexically normalized path of their image so that
+ * every `FileHasher` constructed on the same file ends up with the same index. An existing
+ * store is reloaded only if its files changed on disk behind its back and it has nothing
+ * pending to write.
+ *
+ * @param storePath Path to the hash store image (or to a legacy JSON hash file).
+ * @return Shared pointer to the store associated with the path.
+ */
+std::shared_ptr<HashStore> HashStore::Open(const std::string& storePath) {
+    const std::string imagePath = ImagePathFor(storePath);
+
+    std::string registryKey;
+    try {
+        registryKey = fs::absolute(imagePath).lexically_normal().string();
+    }
+    catch (const std::exception&) {
+        registryKey = imagePath;
+    }
+
+    std::lock_guard<std::mutex> registryLock(s_registryMutex);
+
+    auto it = s_registry.find(registryKey);
+    if (it != s_registry.end()) {
+        std::shared_ptr<HashStore> store = it->second;
+        std::lock_guard<std::mutex> lock(store->m_mutex);
+        if (store->m_dirtyKeys.empty() && store->IsStaleLocked()) {
+            LOG_INFO("Hash store '{}' changed on disk, reloading.", store->m_storePath);
+            store->Load();
+        }
+        return store;
+    }
+
+    std::shared_ptr<HashStore> store(new HashStore(imagePath));
+    {
+        std::lock_guard<std::mutex> lock(store->m_mutex);
+        store->Load();
+    }
+    s_registry.emplace(registryKey, store);
+    return store;
+}
+
+HashStore::HashStore(const std::string& storePath)
+    : m_storePath(storePath),
+    m_journalPath(storePath + kJournalSuffix),
+    m_legacyPath(fs::path(storePath).replace_extension(".json").string()) {
+}
+
+/**
+ * @brief Maps a legacy `.json` store path to the path of its binary image.
+ */
+std::string HashStore::ImagePathFor(const std::string& storePath) {
+    fs::path path(storePath);
+    if (path.extension() == ".json") {
+        path.replace_extension(kImageExtension);
+    }
+    return path.string();
+}
+
+/**
+ * @brief Looks up the record stored for a normalized file path.
+ *
+ * Records changed since the image was written are served from the overlay; all others
+ * are looked up in the mapped image.
+ *
+ * @param key The normalized file path.
+ * @return The stored record, or `std::nullopt` if the path is not tracked.
+ */
+std::optional<HashRecord> HashStore::Get(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_overlay.find(key);
+    if (it != m_overlay.end()) {
+        return it->second;
+    }
+    return m_image.Find(key);
+}
+
+/**
+ * @brief Records the hash of a file in memory and schedules it for writing.
+ *
+ * The record is not written on every call; it is appended to the journal when the store is
+ * flushed, or immediately once `kMaxDirtyRecords` records have changed.
+ *
+ * @param key The normalized file path.
+ * @param hash The SHA-256 hash of the file.
+ */
+void HashStore::Put(const std::string& key, const std::string& hash, const std::string& quickHash) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    SetFileHash(RecordForUpdateLocked(key), hash, quickHash);
+    MarkDirtyLocked(key);
+}
+
+/**
+ * @brief Caches the digests computed for the current on-disk version of a file.
+ *
+ * Only the snapshot part of the record is touched; the recorded `fileHash` stays as it is.
+ * If the cached snapshot describes the same file version, the digests the new snapshot does
+ * not carry (an empty `sha256` or no `merkle` tree) are kept from the cached one.
+ *
+ * @param key The normalized file path.
+ * @param snapshot The digests and the file metadata they belong to.
+ */
+void HashStore::PutSnapshot(const std::string& key, const FileSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    HashRecord& record = RecordForUpdateLocked(key);
+    std::optional<FileSnapshot>& cached = record.snapshot;
+    FileSnapshot merged = snapshot;
+    if (cached && cached->stat == snapshot.stat) {
+        if (merged.sha256.empty()) {
+            merged.sha256 = cached->sha256;
+        }
+        if (!merged.merkle) {
+            merged.merkle = cached->merkle;
+        }
+        if (merged.quickHash.empty()) {
+            merged.quickHash = cached->quickHash;
+        }
+    }
+    cached = std::move(merged);
+    PairQuickHash(record);
+    MarkDirtyLocked(key);
+}
+
+bool HashStore::PutBatch(const std::vector<Update>& updates) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& update : updates) {
+        SetFileHash(RecordForUpdateLocked(update.key), update.fileHash, update.quickHash);
+        m_dirtyKeys.insert(update.key);
+    }
+    return FlushLocked();
+}
+
+void HashStore::NormalizeKeys(const std::function<std::string(const std::string&)>& normalize) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_keysNormalized) {
+        return;
+    }
+    m_keysNormalized = true;
+
+    std::vector<std::pair<std::string, HashRecord>> renamed;
+    for (auto& [key, record] : CollectLocked()) {
+        std::string normalized = normalize(key);
+        if (normalized != key) {
+            renamed.emplace_back(std::move(normalized), std::move(record));
+        }
+    }
+
+    size_t count = 0;
+    for (auto& [key, record] : renamed) {
+        if (m_overlay.count(key) || m_image.Find(key)) {
+            continue;
+        }
+        m_overlay[key] = std::move(record);
+        m_dirtyKeys.insert(key);
+        ++count;
+    }
+
+    if (count > 0) {
+        LOG_INFO("Re-keyed {} records of hash store '{}' to normalized paths.", count, m_storePath);
+        FlushLocked();
+    }
+}
+
+bool HashStore::Empty() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& [key, record] : m_overlay) {
+        if (!record.fileHash.empty()) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < m_image.Count(); ++i) {
+        if (m_image.HasFileHashAt(i) && !m_overlay.count(std::string(m_image.KeyAt(i)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t HashStore::Size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t size = m_overlay.size();
+    for (size_t i = 0; i < m_image.Count(); ++i) {
+        if (!m_overlay.count(std::string(m_image.KeyAt(i)))) {
+            ++size;
+        }
+    }
+    return size;
+}
+
+bool HashStore::Flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return FlushLocked();
+}
+
+bool HashStore::Compact() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return CompactLocked();
+}
+
+/**
+ * @brief Writes every record as indented JSON in the layout of the old JSON hash files.
+ */
+void HashStore::Dump(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    json j = json::object();
+    for (const auto& [key, record] : CollectLocked()) {
+        j[key] = RecordToJson(record);
+    }
+    out << j.dump(4) << std::endl;
+}
+
+void HashStore::DumpFile(const std::string& storePath, std::ostream& out) {
+    HashStore store(ImagePathFor(storePath));
+    {
+        std::lock_guard<std::mutex> lock(store.m_mutex);
+        store.Load(true);
+    }
+    store.Dump(out);
+}
+
+/**
+ * @brief Returns the overlay record of a key, copying it from the image on first change.
+ */
+HashRecord& HashStore::RecordForUpdateLocked(const std::string& key) {
+    auto it = m_overlay.find(key);
+    if (it != m_overlay.end()) {
+        return it->second;
+    }
+    return m_overlay[key] = m_image.Find(key).value_or(HashRecord{});
+}
+
+void HashStore::SetFileHash(HashRecord& record, const std::string& hash, const std::string& quickHash) {
+    record.fileHash = hash;
+    record.quickHash = quickHash;
+    record.timestamp = std::time(nullptr);
+    PairQuickHash(record);
+}
+
+/**
+ * @brief Completes a record's BLAKE2b digest from its snapshot when both describe the same content.
+ *
+ * Equal SHA-256 digests identify the content, so the snapshot's BLAKE2b digest is that of the
+ * recorded content too, whatever version of the file the snapshot was taken from.
+ */
+void HashStore::PairQuickHash(HashRecord& record) {
+    if (record.quickHash.empty() && !record.fileHash.empty() && record.snapshot &&
+        !record.snapshot->quickHash.empty() && record.snapshot->sha256 == record.fileHash) {
+        record.quickHash = record.snapshot->quickHash;
+    }
+}
+
+void HashStore::MarkDirtyLocked(const std::string& key) {
+    m_dirtyKeys.insert(key);
+
+    if (m_dirtyKeys.size() >= kMaxDirtyRecords) {
+        FlushLocked();
+    }
+}
+
+/**
+ * @brief Returns every record of the store: the overlay plus the image records it does not shadow.
+ */
+std::vector<std::pair<std::string, HashRecord>> HashStore::CollectLocked() const {
+    std::vector<std::pair<std::string, HashRecord>> records(m_overlay.begin(), m_overlay.end());
+    records.reserve(m_overlay.size() + m_image.Count());
+    for (size_t i = 0; i < m_image.Count(); ++i) {
+        std::string key(m_image.KeyAt(i));
+        if (!m_overlay.count(key)) {
+            records.emplace_back(std::move(key), m_image.RecordAt(i));
+        }
+    }
+    return records;
+}
+
+/**
+ * @brief Maps the image and replays the journal on top of it.
+ *
+ * A damaged journal line (typically the last one, torn by a crash) is skipped, and the store
+ * is compacted right away so that later appends do not land behind it. A damaged image is
+ * moved aside rather than overwritten. If there is no image yet but a JSON hash file of the
+ * old format exists, it is imported and the store is compacted into a new image. Must be
+ * called with `m_mutex` held.
+ *
+ * @param readOnly Leave the files as they are: read a legacy JSON file without migrating it,
+ *        and neither move a damaged image aside nor compact.
+ */
+void HashStore::Load(bool readOnly) {
+    m_overlay.clear();
+    m_dirtyKeys.clear();
+    m_journalRecords = 0;
+    m_keysNormalized = false;
+
+    HashStoreImage::OpenResult result = m_image.Open(m_storePath);
+    if (result == HashStoreImage::OpenResult::Corrupt && readOnly) {
+        LOG_ERROR("Hash store '{}' is corrupted.", m_storePath);
+    }
+    else if (result == HashStoreImage::OpenResult::Corrupt) {
+        LOG_ERROR("Hash store '{}' is corrupted; keeping it as '{}.corrupt'.", m_storePath, m_storePath);
+
+        std::error_code ec;
+        fs::rename(m_storePath, m_storePath + ".corrupt", ec);
+    }
+
+    bool damaged = false;
+    bool migrated = false;
+    if (result != HashStoreImage::OpenResult::Ok && fs::exists(m_legacyPath)) {
+        migrated = LoadLegacyJson();
+    }
+
+    m_journalRecords = ReplayJournal(m_journalPath, damaged);
+    m_diskState = QueryDiskState();
+
+    if (m_image.Count() == 0 && m_overlay.empty() && !migrated) {
+        LOG_INFO("Hash store '{}' is empty or does not exist yet.", m_storePath);
+    }
+    else {
+        LOG_DEBUG("Loaded hash store '{}' ({} image records, {} journal records).", m_storePath, m_image.Count(), m_journalRecords);
+    }
+
+    if (!readOnly && (damaged || migrated || result == HashStoreImage::OpenResult::Corrupt)) {
+        if (CompactLocked() && migrated) {
+            std::error_code ec;
+            fs::rename(m_legacyPath, m_legacyPath + ".migrated", ec);
+            LOG_INFO("Migrated {} hash records from '{}' to '{}'.", m_image.Count(), m_legacyPath, m_storePath);
+        }
+    }
+}
+
+/**
+ * @brief Imports a JSON hash file written by older versions into the overlay.
+ *
+ * @return true if the file was parsed, false if it is unreadable or corrupted (it is then left in place).
+ */
+bool HashStore::LoadLegacyJson() {
+    std::ifstream storeFile(m_legacyPath);
+    if (!storeFile.is_open()) {
+        LOG_ERROR("Unable to open hash file: {}", m_legacyPath);
+        return false;
+    }
+
+    try {
+        json j;
+        storeFile >> j;
+
+        if (!j.is_object()) {
+            throw std::runtime_error("top-level value is not an object");
+        }
+
+        for (auto& [path, entry] : j.items()) {
+            if (auto record = RecordFromJson(entry)) {
+                m_overlay[path] = std::move(*record);
+            }
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Hash file '{}' is corrupted and cannot be migrated: {}", m_legacyPath, e.what());
+        return false;
+    }
+}
+
+/**
+ * @brief Applies the records of a journal, in order, to the overlay.
+ *
+ * A line holds the records of one flush (`{"records": [...]}`) and is applied completely or
+ * not at all.
+ *
+ * @param journalPath The journal to replay.
+ * @param damaged Set to true if a line of the journal could not be parsed.
+ * @return Number of records read from the journal.
+ */
+size_t HashStore::ReplayJournal(const std::string& journalPath, bool& damaged) {
+    std::ifstream journal(journalPath);
+    if (!journal.is_open()) {
+        return 0;
+    }
+
+    size_t lines = 0;
+    size_t recordCount = 0;
+    std::string line;
+    while (std::getline(journal, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        ++lines;
+
+        try {
+            json entry = json::parse(line);
+            std::vector<std::pair<std::string, HashRecord>> records;
+            for (const auto& item : entry.at("records")) {
+                if (auto record = RecordFromJson(item)) {
+                    records.emplace_back(item.at("path").get<std::string>(), std::move(*record));
+                }
+            }
+            for (auto& [path, record] : records) {
+                m_overlay[path] = std::move(record);
+            }
+            recordCount += records.size();
+        }
+        catch (const std::exception& e) {
+            LOG_WARN("Skipping damaged record {} of hash journal '{}': {}", lines, journalPath, e.what());
+            damaged = true;
+        }
+    }
+    return recordCount;
+}
+
+/**
+ * @brief Appends every record changed since the last flush to the journal.
+ *
+ * The changed records are written as one self-contained JSON line, so they are replayed
+ * all together or not at all, and the journal is flushed to disk before the records are
+ * considered saved. When the journal holds more than
+ * `kMaxJournalRecords` records, or no image exists yet, it is compacted into a new image.
+ * Must be called with `m_mutex` held.
+ *
+ * @return true if the store is clean after the call, false if writing failed.
+ */
+bool HashStore::FlushLocked() {
+    if (m_dirtyKeys.empty()) {
+        return true;
+    }
+
+    try {
+        json records = json::array();
+        for (const auto& key : m_dirtyKeys) {
+            auto it = m_overlay.find(key);
+            if (it == m_overlay.end()) {
+                continue;
+            }
+            json entry = RecordToJson(it->second);
+            entry["path"] = key;
+            records.push_back(std::move(entry));
+        }
+
+        const std::string line = json{ {"records", std::move(records)} }.dump() + '\n';
+        if (!WriteDurably(m_journalPath, line, true)) {
+            LOG_ERROR("Failed to append to hash journal: {}", m_journalPath);
+
+            return false;
+        }
+
+        LOG_INFO("Appended {} hash records to '{}'", m_dirtyKeys.size(), m_journalPath);
+
+        m_journalRecords += m_dirtyKeys.size();
+        m_dirtyKeys.clear();
+        m_diskState = QueryDiskState();
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Exception while saving hash journal '{}': {}", m_journalPath, e.what());
+
+        return false;
+    }
+
+    if (m_journalRecords > kMaxJournalRecords || !m_image.IsOpen()) {
+        CompactLocked();
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the whole store into a new image and removes the journal.
+ *
+ * The image is written to `<image>.tmp`, flushed to disk and renamed over the old image, so
+ * readers only ever see the old or the new image. The old image has to be unmapped for the
+ * rename; if writing fails it is mapped again and nothing is lost. The journal is removed
+ * afterwards; if that step is interrupted, replaying the journal over the new image yields
+ * the same records. Must be called with `m_mutex` held.
+ *
+ * @return true on success, false if writing failed.
+ */
+bool HashStore::CompactLocked() {
+    try {
+        std::vector<std::pair<std::string, HashRecord>> records = CollectLocked();
+        const size_t recordCount = records.size();
+        const std::string image = HashStoreImage::Serialize(std::move(records));
+
+        const std::string tempPath = m_storePath + ".tmp";
+        const bool hadImage = m_image.IsOpen();
+        m_image.Close();
+
+        if (!WriteDurably(tempPath, image, false) || !ReplaceFile(tempPath, m_storePath)) {
+            LOG_ERROR("Failed to write hash store image: {}", m_storePath);
+
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            if (hadImage) {
+                m_image.Open(m_storePath);
+            }
+            return false;
+        }
+
+        if (m_image.Open(m_storePath) != HashStoreImage::OpenResult::Ok) {
+            LOG_ERROR("Failed to map the hash store image just written: {}", m_storePath);
+
+            return false;
+        }
+
+        std::error_code ec;
+        fs::remove(m_journalPath, ec);
+        if (ec) {
+            LOG_WARN("Failed to remove hash journal '{}': {}", m_journalPath, ec.message());
+        }
+
+        LOG_INFO("Compacted {} hash records ({} journal records, {} pending) into '{}' ({} bytes)",
+            recordCount, m_journalRecords, m_dirtyKeys.size(), m_storePath, image.size());
+
+        m_overlay.clear();
+        m_journalRecords = 0;
+        m_dirtyKeys.clear();
+        m_diskState = QueryDiskState();
+        return true;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Exception while compacting hash store '{}': {}", m_storePath, e.what());
+
+        return false;
+    }
+}
+
+/**
+ * @brief Checks whether the image or the journal on disk differs from what the store last saw.
+ */
+bool HashStore::IsStaleLocked() const {
+    return QueryDiskState() != m_diskState;
+}
+
+HashStore::DiskState HashStore::QueryDiskState() const {
+    DiskState state;
+    std::error_code ec;
+
+    auto writeTime = fs::last_write_time(m_storePath, ec);
+    if (!ec) {
+        state.imageWriteTime = writeTime;
+    }
+
+    auto journalSize = fs::file_size(m_journalPath, ec);
+    if (!ec) {
+        state.journalSize = journalSize;
+    }
+    return state;
+}
+
+/**
+ * @brief Converts a raw time value to a human-readable timestamp format.
+ *
+ * This function formats a given `std::time_t` value into a string representation
+ * using the format "YYYY-MM-DD HH:MM:SS".
+ *
+ * @param rawTime The raw time value to format.
+ * @return A formatted string representation of the timestamp.
+ */
+std::string HashStore::GetReadableTime(std::time_t rawTime) {
+    std::tm* timeInfo = std::localtime(&rawTime);
+    std::ostringstream oss;
+    oss << std::put_time(timeInfo, "%Y-%m-%d %H:%M:%S");
+    return oss.str();
+}
+
+/**
+ * @brief Serializes a record in the layout used by both the snapshot and the journal.
+ */
+json HashStore::RecordToJson(const HashRecord& record) {
+    json entry = json::object();
+    if (!record.fileHash.empty()) {
+        entry["file_hash"] = record.fileHash;
+        entry["timestamp"] = record.timestamp;
+        entry["readable_timestamp"] = GetReadableTime(record.timestamp);
+        if (!record.quickHash.empty()) {
+            entry["quick_hash"] = record.quickHash;
+        }
+    }
+    if (record.snapshot) {
+        entry["snapshot"] = SnapshotToJson(*record.snapshot);
+    }
+    return entry;
+}
+
+/**
+ * @brief Parses a record written by `RecordToJson()`.
+ * @return The record, or `std::nullopt` if the entry holds neither a hash nor a snapshot.
+ */
+std::optional<HashRecord> HashStore::RecordFromJson(const json& j) {
+    if (!j.is_object()) {
+        return std::nullopt;
+    }
+
+    HashRecord record;
+    if (j.contains("file_hash") && j["file_hash"].is_string()) {
+        record.fileHash = j["file_hash"].get<std::string>();
+        record.timestamp = j.value("timestamp", static_cast<std::time_t>(0));
+        record.quickHash = j.value("quick_hash", std::string());
+    }
+    if (j.contains("snapshot")) {
+        record.snapshot = SnapshotFromJson(j["snapshot"]);
+    }
+
+    if (record.fileHash.empty() && !record.snapshot) {
+        return std::nullopt;
+    }
+    return record;
+}
+
+json HashStore::SnapshotToJson(const FileSnapshot& snapshot) {
+    json j = {
+        {"sha256", snapshot.sha256},
+        {"size", snapshot.stat.size},
+        {"mtime", snapshot.stat.mtime},
+        {"ctime", snapshot.stat.ctime},
+        {"file_id", snapshot.stat.fileId},
+        {"volume_id", snapshot.stat.volumeId},
+        {"hashed_at", snapshot.hashedAt}
+    };
+
+    if (snapshot.merkle) {
+        j["merkle"] = {
+            {"block_size", snapshot.merkle->blockSize},
+            {"root", snapshot.merkle->root},
+            {"blocks", snapshot.merkle->blocks}
+        };
+    }
+    if (!snapshot.quickHash.empty()) {
+        j["quick_hash"] = snapshot.quickHash;
+    }
+    return j;
+}
+
+std::optional<FileSnapshot> HashStore::SnapshotFromJson(const json& j) {
+    if (!j.is_object() || !j.contains("sha256") || !j["sha256"].is_string()) {
+        return std::nullopt;
+    }
+
+    try {
+        FileSnapshot snapshot;
+        snapshot.sha256 = j["sha256"].get<std::string>();
+        snapshot.quickHash = j.value("quick_hash", std::string());
+        if (j.contains("merkle") && j["merkle"].is_object()) {
+            const json& merkle = j["merkle"];
+            MerkleTree tree;
+            tree.blockSize = merkle.value("block_size", uint64_t{ 0 });
+            tree.root = merkle.value("root", std::string());
+            tree.blocks = merkle.value("blocks", std::vector<std::string>());
+            if (tree.blockSize != 0 && !tree.root.empty() && !tree.blocks.empty()) {
+                snapshot.merkle = std::move(tree);
+            }
+        }
+        snapshot.stat.size = j.value("size", uint64_t{ 0 });
+        snapshot.stat.mtime = j.value("mtime", int64_t{ 0 });
+        snapshot.stat.ctime = j.value("ctime", int64_t{ 0 });
+        snapshot.stat.fileId = j.value("file_id", uint64_t{ 0 });
+        snapshot.stat.volumeId = j.value("volume_id", uint64_t{ 0 });
+        snapshot.hashedAt = j.value("hashed_at", int64_t{ 0 });
+        return snapshot;
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Ignoring invalid snapshot entry: {}", e.what());
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,209 @@
+#ifndef HASHSTORE_H
+#define HASHSTORE_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ctime>
+#include <cstdint>
+#include <ostream>
+#include <functional>
+#include "Logger.h"
+#include "HashRecord.h"
+#include "HashStoreImage.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+/**
+ * @class HashStore
+ * @brief Index of recorded file hashes, persisted as a binary image plus an append-only journal.
+ *
+ * The store lives in two files: a compact binary image (see `HashStoreImage`) holding sorted,
+ * fixed-size records with raw 32-byte digests, and `<image>.journal`, which holds the records
+ * changed since the image was written as JSON lines. The image is memory-mapped and
+ * binary-searched, so opening a store does not parse anything; the journal is replayed into
+ * an in-memory overlay that takes precedence over the image. Modified entries are written
+ * back lazily (write-behind) by appending them to the journal, so a write costs O(record).
+ * Each flush is one journal line, so the records written together are replayed together.
+ * Once the journal grows past `kMaxJournalRecords` it is compacted into a new image, written
+ * to a temporary file, flushed to disk and renamed over the old one. A crash can therefore
+ * lose at most the unsaved records or a torn journal line, never the image.
+ *
+ * Stores written by older versions as a JSON file (`zip_hashes.json`, `service_hashes.json`)
+ * are migrated on first open: the JSON file next to the image, with the same name and a
+ * `.json` extension, is imported and renamed to `<name>.json.migrated`.
+ *
+ * All `FileHasher` instances opened on the same store share a single instance, obtained
+ * through `Open()`, which lives for the rest of the process. Pending changes are written when
+ * a `FileHasher` using the store is destroyed, on an explicit `Flush()`, or once too many
+ * accumulate.
+ */
+class HashStore {
+public:
+    /// Extension of the binary image.
+    static constexpr const char* kImageExtension = ".hashdb";
+    /// Suffix appended to the image path to form the journal path.
+    static constexpr const char* kJournalSuffix = ".journal";
+
+    /**
+     * @brief Returns the shared store for the given file, loading it on first use.
+     *
+     * A path with a `.json` extension names a store of the old format; the store then uses
+     * the image with the same name and the `.hashdb` extension, migrating the JSON file into
+     * it if needed. If the image or the journal was modified on disk by someone else since it
+     * was loaded and the store holds no unsaved changes, it is reloaded.
+     *
+     * @param storePath Path to the hash store image (or to a legacy JSON hash file).
+     * @return Shared pointer to the store associated with the path.
+     */
+    static std::shared_ptr<HashStore> Open(const std::string& storePath);
+
+    HashStore(const HashStore&) = delete;
+    HashStore& operator=(const HashStore&) = delete;
+
+    /**
+     * @brief A file hash to record: the SHA-256 digest and, if known, the BLAKE2b digest of the same content.
+     */
+    struct Update {
+        std::string key;
+        std::string fileHash;
+        std::string quickHash;
+    };
+
+    [[nodiscard]] std::optional<HashRecord> Get(const std::string& key) const;
+    /**
+     * @brief Records the SHA-256 hash of a file, replacing the one recorded before.
+     *
+     * If `quickHash` is empty but the file's cached snapshot has the same SHA-256 digest, the
+     * snapshot's BLAKE2b digest is recorded with it.
+     */
+    void Put(const std::string& key, const std::string& hash, const std::string& quickHash = {});
+    /**
+     * @brief Caches the digests of a file's current content, merging them with a snapshot of the same version.
+     *
+     * If the record's file hash matches the snapshot's SHA-256 digest but has no BLAKE2b digest
+     * yet, the snapshot's one is recorded with it.
+     */
+    void PutSnapshot(const std::string& key, const FileSnapshot& snapshot);
+
+    /**
+     * @brief Records several hashes at once and writes them to disk as a single journal entry.
+     *
+     * The batch is applied in memory and flushed immediately, together with any other pending
+     * changes, as one journal line. After a crash, either all of them are in the store or none.
+     *
+     * @param updates Normalized file paths and their hashes.
+     * @return true if the batch is on disk, false if writing failed (it then stays pending).
+     */
+    bool PutBatch(const std::vector<Update>& updates);
+
+    /**
+     * @brief Re-keys records stored under a key that `normalize` would spell differently.
+     *
+     * Such records were written before the key normalization changed. Each is copied to its
+     * normalized key unless that key already has a record, so lookups with normalized keys
+     * find them again. The old keys stay in the store. The keys are only checked once per load.
+     *
+     * @param normalize Maps a key to its normalized form.
+     */
+    void NormalizeKeys(const std::function<std::string(const std::string&)>& normalize);
+
+    /**
+     * @brief Checks whether any file hash has been recorded (cached snapshots do not count).
+     */
+    [[nodiscard]] bool Empty() const;
+    [[nodiscard]] size_t Size() const;
+
+    /**
+     * @brief Appends unsaved changes to the journal, compacting it if it has grown too long.
+     * @return true if the store is clean after the call, false if writing failed.
+     */
+    bool Flush();
+
+    /**
+     * @brief Writes the whole store into a new image and discards the journal.
+     * @return true on success, false if writing failed (the previous files are left intact).
+     */
+    bool Compact();
+
+    /**
+     * @brief Writes every record as indented JSON, sorted by path, for human inspection.
+     */
+    void Dump(std::ostream& out) const;
+
+    /**
+     * @brief Writes the records of a store as `Dump()` does, without changing anything on disk.
+     *
+     * Unlike `Open()`, a legacy JSON file is read but not migrated, a damaged image is not
+     * moved aside and a damaged journal is not compacted. The store is not shared.
+     *
+     * @param storePath Path to the hash store image (or to a legacy JSON hash file).
+     */
+    static void DumpFile(const std::string& storePath, std::ostream& out);
+
+    [[nodiscard]] const std::string& GetPath() const { return m_storePath; }
+
+private:
+    explicit HashStore(const std::string& storePath);
+
+    /// Number of unsaved records after which a write is forced instead of deferred.
+    static constexpr size_t kMaxDirtyRecords = 64;
+    /// Number of journal lines after which the journal is folded into a new image.
+    static constexpr size_t kMaxJournalRecords = 256;
+
+    /**
+     * @brief What the store files looked like on disk when they were last read or written.
+     */
+    struct DiskState {
+        std::optional<fs::file_time_type> imageWriteTime;
+        std::optional<uintmax_t> journalSize;
+
+        bool operator==(const DiskState& other) const {
+            return imageWriteTime == other.imageWriteTime && journalSize == other.journalSize;
+        }
+        bool operator!=(const DiskState& other) const { return !(*this == other); }
+    };
+
+    std::string m_storePath;
+    std::string m_journalPath;
+    std::string m_legacyPath;
+    mutable std::mutex m_mutex;
+    HashStoreImage m_image;
+    std::unordered_map<std::string, HashRecord> m_overlay;
+    std::unordered_set<std::string> m_dirtyKeys;
+    size_t m_journalRecords = 0;
+    DiskState m_diskState;
+    bool m_keysNormalized = false;
+
+    static std::mutex s_registryMutex;
+    static std::unordered_map<std::string, std::shared_ptr<HashStore>> s_registry;
+
+    static std::string ImagePathFor(const std::string& storePath);
+
+    void Load(bool readOnly = false);
+    bool LoadLegacyJson();
+    size_t ReplayJournal(const std::string& journalPath, bool& damaged);
+    HashRecord& RecordForUpdateLocked(const std::string& key);
+    static void SetFileHash(HashRecord& record, const std::string& hash, const std::string& quickHash);
+    static void PairQuickHash(HashRecord& record);
+    void MarkDirtyLocked(const std::string& key);
+    std::vector<std::pair<std::string, HashRecord>> CollectLocked() const;
+    bool FlushLocked();
+    bool CompactLocked();
+    bool IsStaleLocked() const;
+    DiskState QueryDiskState() const;
+    static std::string GetReadableTime(std::time_t rawTime);
+    static json RecordToJson(const HashRecord& record);
+    static std::optional<HashRecord> RecordFromJson(const json& j);
+    static json SnapshotToJson(const FileSnapshot& snapshot);
+    static std::optional<FileSnapshot> SnapshotFromJson(const json& j);
+};
+
+#endif // HASHSTORE_H
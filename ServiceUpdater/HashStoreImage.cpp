@@ -0,0 +1,436 @@
+#include "HashStoreImage.h"
+#include "HashEngine.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct HashStoreImage::DiskHeader {
+    char magic[8];           ///< `kMagic`.
+    uint32_t version;        ///< `kVersion`.
+    uint32_t recordSize;     ///< `sizeof(DiskRecord)`.
+    uint64_t recordCount;
+    uint64_t recordsOffset;
+    uint64_t snapshotCount;
+    uint64_t snapshotsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t blocksOffset;
+    uint64_t blockCount;     ///< Number of 32-byte entries in the block digest table.
+};
+
+struct HashStoreImage::DiskRecord {
+    uint64_t keyHash;        ///< FNV-1a hash of the key; primary sort key.
+    uint64_t keyOffset;      ///< Offset of the key in the string table.
+    uint32_t keyLength;
+    uint32_t flags;          ///< Combination of the `kHas*` flags.
+    int64_t timestamp;       ///< Time the file hash was recorded.
+    uint8_t fileHash[32];
+    uint8_t quickHash[32];   ///< BLAKE2b-256 digest of the content of `fileHash`, if `kHasQuickHash` is set.
+    uint64_t snapshotIndex;  ///< Index in the snapshot table, if `kHasSnapshot` is set.
+};
+
+/**
+ * @brief Snapshot of a file's content as last seen on disk; kept out of `DiskRecord` so the
+ *        array that is binary-searched stays small.
+ */
+struct HashStoreImage::DiskSnapshot {
+    uint64_t size;
+    int64_t mtime;
+    int64_t ctime;
+    uint64_t fileId;
+    uint64_t volumeId;
+    int64_t hashedAt;
+    uint8_t sha256[32];
+    uint8_t quickHash[32];
+
+    // Merkle tree of the snapshot; its leaves live in the block digest table.
+    uint64_t merkleBlockSize;
+    uint64_t merkleFirstBlock;
+    uint64_t merkleBlockCount;
+    uint8_t merkleRoot[32];
+};
+
+namespace {
+    constexpr char kMagic[8] = { 'N', 'X', 'H', 'A', 'S', 'H', 'D', 'B' };
+    constexpr uint32_t kVersion = 1;
+    constexpr size_t kDigestSize = 32;
+
+    constexpr uint32_t kHasFileHash = 1u << 0;
+    constexpr uint32_t kHasSnapshot = 1u << 1;
+    constexpr uint32_t kHasSnapshotSha256 = 1u << 2;
+    constexpr uint32_t kHasMerkle = 1u << 3;
+    constexpr uint32_t kHasQuickHash = 1u << 4;
+    constexpr uint32_t kHasSnapshotQuickHash = 1u << 5;
+
+    uint64_t HashKey(std::string_view key) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    int HexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool HexToDigest(const std::string& hex, uint8_t* out) {
+        if (hex.size() != kDigestSize * 2) {
+            return false;
+        }
+        for (size_t i = 0; i < kDigestSize; ++i) {
+            int high = HexValue(hex[2 * i]);
+            int low = HexValue(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            out[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        return true;
+    }
+
+    template <typename T>
+    void Append(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+/**
+ * @brief Maps an image file read-only and validates its header.
+ *
+ * A mapped file cannot be replaced on Windows, so the owner must `Close()` the image before
+ * writing a new one over it.
+ *
+ * @param imagePath The image file.
+ * @return Whether the image is usable, missing or corrupt.
+ */
+HashStoreImage::OpenResult HashStoreImage::Open(const fs::path& imagePath) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(imagePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        DWORD error = GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? OpenResult::Missing : OpenResult::Corrupt;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(DiskHeader))) {
+        CloseHandle(file);
+        return OpenResult::Corrupt;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        LOG_ERROR("Failed to map hash store image '{}'. Error code: {}", imagePath.string(), GetLastError());
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return OpenResult::Corrupt;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    int fd = open(imagePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? OpenResult::Missing : OpenResult::Corrupt;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(DiskHeader))) {
+        close(fd);
+        return OpenResult::Corrupt;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        LOG_ERROR("Failed to map hash store image '{}': {}", imagePath.string(), errno);
+        return OpenResult::Corrupt;
+    }
+    posix_madvise(view, static_cast<size_t>(st.st_size), POSIX_MADV_RANDOM);
+    m_size = static_cast<uint64_t>(st.st_size);
+#endif
+
+    m_data = static_cast<const unsigned char*>(view);
+
+    const DiskHeader& header = Header();
+    const bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.version == kVersion &&
+        header.recordSize == sizeof(DiskRecord) &&
+        header.recordsOffset >= sizeof(DiskHeader) && header.recordsOffset % alignof(DiskRecord) == 0 &&
+        header.recordsOffset <= m_size &&
+        header.recordCount <= (m_size - header.recordsOffset) / sizeof(DiskRecord) &&
+        header.snapshotsOffset <= m_size && header.snapshotsOffset % alignof(DiskSnapshot) == 0 &&
+        header.snapshotCount <= (m_size - header.snapshotsOffset) / sizeof(DiskSnapshot) &&
+        header.stringsOffset <= m_size && header.stringsSize <= m_size - header.stringsOffset &&
+        header.blocksOffset <= m_size && header.blockCount <= (m_size - header.blocksOffset) / kDigestSize;
+
+    if (!valid) {
+        LOG_ERROR("Hash store image '{}' has an invalid header.", imagePath.string());
+        Close();
+        return OpenResult::Corrupt;
+    }
+
+    m_count = static_cast<size_t>(header.recordCount);
+    return OpenResult::Ok;
+}
+
+void HashStoreImage::Close() {
+    if (!m_data) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(m_data), static_cast<size_t>(m_size));
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+}
+
+/**
+ * @brief Looks up the record of a key.
+ *
+ * The search compares key hashes only; the key itself is compared for the (usually single)
+ * record whose hash matches.
+ *
+ * @param key The normalized file path.
+ * @return The record, or `std::nullopt` if the key is not in the image.
+ */
+std::optional<HashRecord> HashStoreImage::Find(std::string_view key) const {
+    const uint64_t keyHash = HashKey(key);
+
+    size_t low = 0;
+    size_t high = m_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (RecordRef(middle).keyHash < keyHash) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    for (size_t i = low; i < m_count && RecordRef(i).keyHash == keyHash; ++i) {
+        if (KeyAt(i) == key) {
+            return RecordAt(i);
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view HashStoreImage::KeyAt(size_t index) const {
+    const DiskHeader& header = Header();
+    const DiskRecord& record = RecordRef(index);
+    if (record.keyOffset > header.stringsSize || record.keyLength > header.stringsSize - record.keyOffset) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(m_data + header.stringsOffset + record.keyOffset), record.keyLength);
+}
+
+bool HashStoreImage::HasFileHashAt(size_t index) const {
+    return (RecordRef(index).flags & kHasFileHash) != 0;
+}
+
+/**
+ * @brief Decodes the record at a position of the sorted record array.
+ */
+HashRecord HashStoreImage::RecordAt(size_t index) const {
+    const DiskRecord& disk = RecordRef(index);
+    HashRecord record;
+
+    if (disk.flags & kHasFileHash) {
+        record.fileHash = HashEngine::ToHex(disk.fileHash, kDigestSize);
+        record.timestamp = static_cast<std::time_t>(disk.timestamp);
+        if (disk.flags & kHasQuickHash) {
+            record.quickHash = HashEngine::ToHex(disk.quickHash, kDigestSize);
+        }
+    }
+
+    const DiskHeader& header = Header();
+    if ((disk.flags & kHasSnapshot) && disk.snapshotIndex < header.snapshotCount) {
+        const DiskSnapshot& diskSnapshot =
+            reinterpret_cast<const DiskSnapshot*>(m_data + header.snapshotsOffset)[disk.snapshotIndex];
+        FileSnapshot snapshot;
+        snapshot.stat.size = diskSnapshot.size;
+        snapshot.stat.mtime = diskSnapshot.mtime;
+        snapshot.stat.ctime = diskSnapshot.ctime;
+        snapshot.stat.fileId = diskSnapshot.fileId;
+        snapshot.stat.volumeId = diskSnapshot.volumeId;
+        snapshot.hashedAt = diskSnapshot.hashedAt;
+        if (disk.flags & kHasSnapshotSha256) {
+            snapshot.sha256 = HashEngine::ToHex(diskSnapshot.sha256, kDigestSize);
+        }
+        if (disk.flags & kHasSnapshotQuickHash) {
+            snapshot.quickHash = HashEngine::ToHex(diskSnapshot.quickHash, kDigestSize);
+        }
+
+        if ((disk.flags & kHasMerkle) && diskSnapshot.merkleFirstBlock <= header.blockCount &&
+            diskSnapshot.merkleBlockCount <= header.blockCount - diskSnapshot.merkleFirstBlock) {
+            MerkleTree tree;
+            tree.blockSize = diskSnapshot.merkleBlockSize;
+            tree.root = HashEngine::ToHex(diskSnapshot.merkleRoot, kDigestSize);
+            tree.blocks.reserve(static_cast<size_t>(diskSnapshot.merkleBlockCount));
+            const unsigned char* blocks = m_data + header.blocksOffset + diskSnapshot.merkleFirstBlock * kDigestSize;
+            for (uint64_t i = 0; i < diskSnapshot.merkleBlockCount; ++i) {
+                tree.blocks.push_back(HashEngine::ToHex(blocks + i * kDigestSize, kDigestSize));
+            }
+            snapshot.merkle = std::move(tree);
+        }
+
+        record.snapshot = std::move(snapshot);
+    }
+
+    return record;
+}
+
+/**
+ * @brief Encodes records as an image: header, sorted records, string table, block digests.
+ */
+std::string HashStoreImage::Serialize(std::vector<std::pair<std::string, HashRecord>> records) {
+    static_assert(sizeof(DiskHeader) == 80, "image header layout changed");
+    static_assert(sizeof(DiskRecord) == 104, "image record layout changed");
+    static_assert(sizeof(DiskSnapshot) == 168, "image snapshot layout changed");
+
+    std::vector<std::pair<uint64_t, size_t>> order;
+    order.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        order.emplace_back(HashKey(records[i].first), i);
+    }
+    std::sort(order.begin(), order.end(), [&](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : records[a.second].first < records[b.second].first;
+        });
+
+    std::vector<DiskRecord> diskRecords;
+    diskRecords.reserve(records.size());
+    std::vector<DiskSnapshot> diskSnapshots;
+    std::string strings;
+    std::string blocks;
+
+    for (const auto& [keyHash, index] : order) {
+        const auto& [key, record] = records[index];
+
+        DiskRecord disk{};
+        disk.keyHash = keyHash;
+        disk.keyOffset = strings.size();
+        disk.keyLength = static_cast<uint32_t>(key.size());
+        strings += key;
+
+        if (!record.fileHash.empty()) {
+            if (HexToDigest(record.fileHash, disk.fileHash)) {
+                disk.flags |= kHasFileHash;
+                disk.timestamp = static_cast<int64_t>(record.timestamp);
+                if (HexToDigest(record.quickHash, disk.quickHash)) {
+                    disk.flags |= kHasQuickHash;
+                }
+            }
+            else {
+                LOG_WARN("Dropping malformed hash '{}' recorded for '{}'.", record.fileHash, key);
+            }
+        }
+
+        if (record.snapshot) {
+            const FileSnapshot& snapshot = *record.snapshot;
+            DiskSnapshot diskSnapshot{};
+            diskSnapshot.size = snapshot.stat.size;
+            diskSnapshot.mtime = snapshot.stat.mtime;
+            diskSnapshot.ctime = snapshot.stat.ctime;
+            diskSnapshot.fileId = snapshot.stat.fileId;
+            diskSnapshot.volumeId = snapshot.stat.volumeId;
+            diskSnapshot.hashedAt = snapshot.hashedAt;
+            if (HexToDigest(snapshot.sha256, diskSnapshot.sha256)) {
+                disk.flags |= kHasSnapshotSha256;
+            }
+            if (HexToDigest(snapshot.quickHash, diskSnapshot.quickHash)) {
+                disk.flags |= kHasSnapshotQuickHash;
+            }
+
+            if (snapshot.merkle && HexToDigest(snapshot.merkle->root, diskSnapshot.merkleRoot)) {
+                std::string treeBlocks(snapshot.merkle->blocks.size() * kDigestSize, '\0');
+                bool ok = true;
+                for (size_t i = 0; ok && i < snapshot.merkle->blocks.size(); ++i) {
+                    ok = HexToDigest(snapshot.merkle->blocks[i], reinterpret_cast<uint8_t*>(&treeBlocks[i * kDigestSize]));
+                }
+                if (ok) {
+                    disk.flags |= kHasMerkle;
+                    diskSnapshot.merkleBlockSize = snapshot.merkle->blockSize;
+                    diskSnapshot.merkleFirstBlock = blocks.size() / kDigestSize;
+                    diskSnapshot.merkleBlockCount = snapshot.merkle->blocks.size();
+                    blocks += treeBlocks;
+                }
+            }
+
+            disk.flags |= kHasSnapshot;
+            disk.snapshotIndex = diskSnapshots.size();
+            diskSnapshots.push_back(diskSnapshot);
+        }
+
+        if (disk.flags != 0) {
+            diskRecords.push_back(disk);
+        }
+        else {
+            strings.resize(disk.keyOffset);
+        }
+    }
+
+    DiskHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.recordSize = sizeof(DiskRecord);
+    header.recordCount = diskRecords.size();
+    header.recordsOffset = sizeof(DiskHeader);
+    header.snapshotCount = diskSnapshots.size();
+    header.snapshotsOffset = header.recordsOffset + diskRecords.size() * sizeof(DiskRecord);
+    header.stringsOffset = header.snapshotsOffset + diskSnapshots.size() * sizeof(DiskSnapshot);
+    header.stringsSize = strings.size();
+    header.blocksOffset = (header.stringsOffset + strings.size() + 7) / 8 * 8;
+    header.blockCount = blocks.size() / kDigestSize;
+
+    std::string image;
+    image.reserve(static_cast<size_t>(header.blocksOffset + blocks.size()));
+    Append(image, header);
+    for (const auto& disk : diskRecords) {
+        Append(image, disk);
+    }
+    for (const auto& diskSnapshot : diskSnapshots) {
+        Append(image, diskSnapshot);
+    }
+    image += strings;
+    image.resize(static_cast<size_t>(header.blocksOffset), '\0');
+    image += blocks;
+    return image;
+}
+
+const HashStoreImage::DiskHeader& HashStoreImage::Header() const {
+    return *reinterpret_cast<const DiskHeader*>(m_data);
+}
+
+const HashStoreImage::DiskRecord& HashStoreImage::RecordRef(size_t index) const {
+    return reinterpret_cast<const DiskRecord*>(m_data + Header().recordsOffset)[index];
+}
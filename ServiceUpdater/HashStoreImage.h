@@ -0,0 +1,89 @@
+#ifndef HASHSTOREIMAGE_H
+#define HASHSTOREIMAGE_H
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "Logger.h"
+#include "HashRecord.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @class HashStoreImage
+ * @brief Read-only, memory-mapped view of a binary hash store snapshot.
+ *
+ * The file consists of a fixed header, an array of fixed-size records sorted by the 64-bit
+ * FNV-1a hash of their key (then by key), a table of fixed-size file snapshots referenced by
+ * the records, a string table holding the keys, and a table of raw 32-byte Merkle block
+ * digests. Digests are stored as raw bytes rather than hex text.
+ * Opening an image only maps it and checks the header; a lookup is a binary search over
+ * the record array that touches the string table only for records whose key hash matches.
+ *
+ * All integers are little-endian, the byte order of every platform the service runs on.
+ */
+class HashStoreImage {
+public:
+    enum class OpenResult {
+        Ok,       ///< The image is mapped and ready for lookups.
+        Missing,  ///< The file does not exist.
+        Corrupt   ///< The file exists but is not a valid image.
+    };
+
+    HashStoreImage() = default;
+    ~HashStoreImage() { Close(); }
+
+    HashStoreImage(const HashStoreImage&) = delete;
+    HashStoreImage& operator=(const HashStoreImage&) = delete;
+
+    /**
+     * @brief Maps an image file, replacing any image mapped before.
+     */
+    OpenResult Open(const fs::path& imagePath);
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const { return m_data != nullptr; }
+    [[nodiscard]] size_t Count() const { return m_count; }
+
+    /**
+     * @brief Looks up the record of a key by binary search.
+     */
+    [[nodiscard]] std::optional<HashRecord> Find(std::string_view key) const;
+
+    [[nodiscard]] std::string_view KeyAt(size_t index) const;
+    [[nodiscard]] HashRecord RecordAt(size_t index) const;
+    [[nodiscard]] bool HasFileHashAt(size_t index) const;
+
+    /**
+     * @brief Encodes records as an image file.
+     *
+     * Digests that are not 64-character hex SHA-256 values cannot be represented and are
+     * left out with a warning.
+     *
+     * @param records The records to encode, in any order; keys must be unique.
+     * @return The content of the image file.
+     */
+    static std::string Serialize(std::vector<std::pair<std::string, HashRecord>> records);
+
+private:
+    struct DiskHeader;
+    struct DiskRecord;
+    struct DiskSnapshot;
+
+    const unsigned char* m_data = nullptr;
+    uint64_t m_size = 0;
+    size_t m_count = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+
+    const DiskHeader& Header() const;
+    const DiskRecord& RecordRef(size_t index) const;
+};
+
+#endif // HASHSTOREIMAGE_H
@@ -0,0 +1,124 @@
+#include "HttpHeaders.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace {
+    std::string_view Trim(std::string_view value) {
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+
+    std::string ToLower(std::string_view value) {
+        std::string lower(value);
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return lower;
+    }
+
+    std::optional<uint64_t> ParseUnsigned(std::string_view value) {
+        value = Trim(value);
+        uint64_t number = 0;
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+        if (ec != std::errc() || end != value.data() + value.size() || value.empty()) {
+            return std::nullopt;
+        }
+        return number;
+    }
+}
+
+std::string HttpValidators::IfRangeValue() const {
+    if (!etag.empty() && etag.rfind("W/", 0) != 0) {
+        return etag;
+    }
+    return lastModified;
+}
+
+size_t HttpResponseHeaders::HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    const size_t length = size * nitems;
+    if (!buffer || !userdata) {
+        return 0;
+    }
+
+    static_cast<HttpResponseHeaders*>(userdata)->ParseLine(std::string_view(buffer, length));
+    return length;
+}
+
+void HttpResponseHeaders::ParseLine(std::string_view line) {
+    line = Trim(line);
+    if (line.empty()) {
+        return;
+    }
+
+    if (line.rfind("HTTP/", 0) == 0) {
+        Clear();
+        size_t space = line.find(' ');
+        if (space != std::string_view::npos) {
+            auto code = ParseUnsigned(line.substr(space + 1, 3));
+            m_status = code ? static_cast<long>(*code) : 0;
+        }
+        return;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+        return;
+    }
+    m_values[ToLower(Trim(line.substr(0, colon)))] = std::string(Trim(line.substr(colon + 1)));
+}
+
+std::optional<std::string> HttpResponseHeaders::Get(std::string_view name) const {
+    auto it = m_values.find(ToLower(name));
+    if (it == m_values.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+HttpValidators HttpResponseHeaders::Validators() const {
+    HttpValidators validators;
+    validators.etag = Get("ETag").value_or("");
+    validators.lastModified = Get("Last-Modified").value_or("");
+    return validators;
+}
+
+std::optional<uint64_t> HttpResponseHeaders::ContentLength() const {
+    auto value = Get("Content-Length");
+    return value ? ParseUnsigned(*value) : std::nullopt;
+}
+
+std::optional<uint64_t> HttpResponseHeaders::ResourceSize() const {
+    if (m_status == 206) {
+        auto range = Get("Content-Range");
+        size_t slash = range ? range->rfind('/') : std::string::npos;
+        if (slash == std::string::npos) {
+            return std::nullopt;
+        }
+        return ParseUnsigned(std::string_view(*range).substr(slash + 1));
+    }
+    return ContentLength();
+}
+
+ContentFingerprint HttpResponseHeaders::Fingerprint() const {
+    ContentFingerprint fingerprint;
+    auto md5 = Get("x-ms-blob-content-md5");
+    if (!md5 && m_status != 206) {
+        md5 = Get("Content-MD5");
+    }
+    auto length = ResourceSize();
+    if (md5 && !md5->empty() && length) {
+        fingerprint.md5 = *md5;
+        fingerprint.length = *length;
+    }
+    return fingerprint;
+}
+
+void HttpResponseHeaders::Clear() {
+    m_status = 0;
+    m_values.clear();
+}
@@ -0,0 +1,97 @@
+#ifndef HTTPHEADERS_H
+#define HTTPHEADERS_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <optional>
+#include <cstdint>
+
+/**
+ * @brief Cache validators of an HTTP response, used to tell whether a resource has changed.
+ */
+struct HttpValidators {
+    std::string etag;          ///< `ETag` header, including quotes and any `W/` prefix.
+    std::string lastModified;  ///< `Last-Modified` header, as sent by the server.
+
+    [[nodiscard]] bool Empty() const { return etag.empty() && lastModified.empty(); }
+
+    /**
+     * @brief Returns the value to send in an `If-Range` header.
+     *
+     * `If-Range` only accepts a strong ETag, so a weak ETag is skipped in favor of
+     * `Last-Modified`. An empty result means the range request cannot be validated.
+     */
+    [[nodiscard]] std::string IfRangeValue() const;
+
+    bool operator==(const HttpValidators& other) const {
+        return etag == other.etag && lastModified == other.lastModified;
+    }
+    bool operator!=(const HttpValidators& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Identity of a blob's content as reported by the server: its MD5 and length.
+ */
+struct ContentFingerprint {
+    std::string md5;      ///< Base64 encoded MD5 of the whole content.
+    uint64_t length = 0;  ///< Length of the whole content in bytes.
+
+    [[nodiscard]] bool Empty() const { return md5.empty(); }
+
+    bool operator==(const ContentFingerprint& other) const {
+        return md5 == other.md5 && length == other.length;
+    }
+    bool operator!=(const ContentFingerprint& other) const { return !(*this == other); }
+};
+
+/**
+ * @class HttpResponseHeaders
+ * @brief Collects the headers of an HTTP response received through libcurl.
+ *
+ * Pass `HeaderCallback` as `CURLOPT_HEADERFUNCTION` and the object as `CURLOPT_HEADERDATA`.
+ * Every status line starts a new response, so after redirects or interim responses the
+ * object describes the final response only. Header names are matched case-insensitively.
+ */
+class HttpResponseHeaders {
+public:
+    static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata);
+
+    /// Status code of the last status line, or 0 if none was received.
+    [[nodiscard]] long Status() const { return m_status; }
+
+    /// Returns the value of a header, with surrounding white space removed.
+    [[nodiscard]] std::optional<std::string> Get(std::string_view name) const;
+
+    [[nodiscard]] HttpValidators Validators() const;
+
+    /// Value of `Content-Length`, if present and valid.
+    [[nodiscard]] std::optional<uint64_t> ContentLength() const;
+
+    /**
+     * @brief Returns the size of the complete resource.
+     *
+     * For a partial response (206) this is the total from `Content-Range: bytes a-b/total`,
+     * otherwise the `Content-Length`.
+     */
+    [[nodiscard]] std::optional<uint64_t> ResourceSize() const;
+
+    /**
+     * @brief Returns the MD5 and length of the complete resource, if the server reported them.
+     *
+     * Azure Blob Storage sends the MD5 of the whole blob as `x-ms-blob-content-md5` (also on
+     * range responses) and as `Content-MD5` on full responses. Without either, the result
+     * is empty.
+     */
+    [[nodiscard]] ContentFingerprint Fingerprint() const;
+
+    void Clear();
+
+private:
+    long m_status = 0;
+    std::unordered_map<std::string, std::string> m_values;
+
+    void ParseLine(std::string_view line);
+};
+
+#endif // HTTPHEADERS_H
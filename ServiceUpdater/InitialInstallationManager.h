@@ -143,11 +143,15 @@ public:
             }
 
             bool installationPerformed = false;
+            m_serviceFileHasher.BeginBatch();
             for (const auto& [serviceName, exePath, newExeName] : m_services) {
                 if (InstallServiceIfNeeded(newExeName, serviceName)) {
                     installationPerformed = true;
                 }
             }
+            if (!m_serviceFileHasher.Commit()) {
+                LOG_ERROR("Failed to record service hashes in '{}'", m_serviceHashFile);
+            }
 
             if (installationPerformed) {
                 LOG_INFO("Initial service installation completed successfully.");
@@ -236,7 +240,7 @@ private:
 
         std::vector<std::wstring> args = (serviceName == L"DCSStreamingAgentWatchdog") ? std::vector<std::wstring>{} : GenerateServiceArguments();
 
-        ServiceManager serviceManager(serviceName, newExePath, args);
+        ServiceManager serviceManager(serviceName, newExePath, args, &m_serviceFileHasher);
         return serviceManager.UpdateService();
     }
 
@@ -5,6 +5,9 @@
 #include "UpgradePathManager.h"
 #include "InitialInstallationManager.h"
 #include "ServiceUpgradeManager.h"
+#include "BandwidthLimiter.h"
+#include "TransferLoop.h"
+#include "SiteCache.h"
 #include <libcron/Cron.h>
 #include "spdlog/spdlog.h"
 #include <iostream>
@@ -47,6 +50,7 @@ public:
             HandleConfigurationFiles();
 
             Logger::Init();
+            BandwidthLimiter::Instance().LoadFromConfig(configFilePath);
             return true;
         }
         catch (std::exception) {
@@ -331,11 +335,14 @@ public:
         try {
             spdlog::info("[NexusManager] Starting...");
 
+            TransferLoop::Instance().Resume();
+
             // 1. Load Configuration FIRST (needed for installation)
             if (!LoadConfiguration()) {
                 spdlog::error("[NexusManager] Failed to load configuration.");
                 return;
             }
+            StartSiteCache();
 
             // 2. Perform Initial Installation (if required)
             if (PerformInitialInstallation()) {
@@ -363,16 +370,21 @@ public:
 
     /**
      * @brief Stops NexusManager: Stops the cron scheduler and service operations.
+     *
+     * Downloads in progress are aborted rather than waited for, so the scheduler thread
+     * can be joined right away; an interrupted package download resumes on the next run.
      */
     void StopNexusManager() {
         try {
             spdlog::info("[NexusManager] Stopping...");
 
             running = false;  // Set the flag to stop the cron loop
+            TransferLoop::Instance().AbortAll();
 
             if (schedulerThread.joinable()) {
                 schedulerThread.join();  // Wait for cron thread to exit
             }
+            SiteCacheServer::Instance().Stop();
 
             spdlog::info("[NexusManager] Stopped successfully.");
         }
@@ -393,6 +405,21 @@ private:
     std::thread schedulerThread;
 
 
+    /**
+     * @brief Starts the site cache server if this node has the `Server` site cache role.
+     */
+    void StartSiteCache() {
+        SiteCacheConfig siteCache = SiteCacheConfig::Load(configFilePath);
+        if (siteCache.role != SiteCacheRole::Server) {
+            return;
+        }
+
+        UpgradePathManager pathManager;
+        if (!SiteCacheServer::Instance().Start(siteCache, pathManager.GetSiteCacheDirectory())) {
+            spdlog::error("[NexusManager] Failed to start the site cache; other nodes download from the cloud.");
+        }
+    }
+
     /**
      * @brief Executes the initial installation process.
      *
@@ -447,6 +474,9 @@ private:
         try {
             spdlog::info("[Service Upgrade] Checking for service updates...");
 
+            // Pick up edits of the bandwidth limit without restarting the service
+            BandwidthLimiter::Instance().LoadFromConfig(configFilePath);
+
             UpgradePathManager pathManager;
 
             std::string blobName = pathManager.GetBlobName();
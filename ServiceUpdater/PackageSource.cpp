@@ -0,0 +1,104 @@
+#include "PackageSource.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <fstream>
+#include "Logger.h"
+
+using json = nlohmann::json;
+
+namespace {
+    /**
+     * @brief Turns a `file://` URL into a file system path; other mirrors are returned as given.
+     *
+     * `file:///D:/updates` becomes `D:/updates`, `file://server/share` the UNC path
+     * `//server/share`.
+     */
+    std::string MirrorLocation(std::string mirror) {
+        const std::string scheme = "file://";
+        if (mirror.compare(0, scheme.size(), scheme) == 0) {
+            std::string rest = mirror.substr(scheme.size());
+            if (rest.size() > 2 && rest[0] == '/' && rest[2] == ':') {
+                mirror = rest.substr(1);
+            }
+            else if (!rest.empty() && rest[0] == '/') {
+                mirror = rest;
+            }
+            else {
+                mirror = "//" + rest;
+            }
+        }
+        while (mirror.size() > 1 && (mirror.back() == '/' || mirror.back() == '\\')) {
+            mirror.pop_back();
+        }
+        return mirror;
+    }
+}
+
+PackageSourcesConfig PackageSourcesConfig::Load(const std::string& configFilePath) {
+    try {
+        std::ifstream file(configFilePath);
+        if (!file.is_open()) {
+            return {};
+        }
+
+        json config = json::parse(file);
+        if (!config.contains("PackageSources")) {
+            return {};
+        }
+
+        const json& section = config["PackageSources"];
+        PackageSourcesConfig result;
+        result.secondaryRegions = section.value("SecondaryRegions", std::vector<std::string>());
+        for (const std::string& mirror : section.value("Mirrors", std::vector<std::string>())) {
+            if (!mirror.empty()) {
+                result.mirrors.push_back(MirrorLocation(mirror));
+            }
+        }
+        result.race = section.value("Race", false);
+        return result;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Invalid 'PackageSources' in '{}' ({}); using the primary region only.", configFilePath, e.what());
+
+        return {};
+    }
+}
+
+bool PackageSource::IsUrl(const std::string& location) {
+    const size_t scheme = location.find("://");
+    return scheme != std::string::npos && scheme > 1;
+}
+
+SourceHealth& SourceHealth::Instance() {
+    static SourceHealth health;
+    return health;
+}
+
+void SourceHealth::RecordSuccess(const std::string& source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_records.erase(source);
+}
+
+void SourceHealth::RecordFailure(const std::string& source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Record& record = m_records[source];
+    ++record.failures;
+
+    auto cooldown = kBaseCooldown * (1LL << std::min(record.failures - 1, 16));
+    cooldown = std::min<decltype(cooldown)>(cooldown, kMaxCooldown);
+    record.retryAt = Clock::now() + cooldown;
+    LOG_WARN("Package source '{}' failed ({} in a row); it is tried last for the next {} s.",
+        source, record.failures, cooldown.count());
+}
+
+void SourceHealth::Order(std::vector<PackageSource>& sources) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Clock::time_point now = Clock::now();
+    auto penalty = [&](const PackageSource& source) {
+        auto it = m_records.find(source.name);
+        return it == m_records.end() || it->second.retryAt <= now ? 0 : it->second.failures;
+    };
+    std::stable_sort(sources.begin(), sources.end(), [&](const PackageSource& a, const PackageSource& b) {
+        return penalty(a) < penalty(b);
+    });
+}
@@ -0,0 +1,93 @@
+#ifndef PACKAGESOURCE_H
+#define PACKAGESOURCE_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "HttpHeaders.h"
+
+/**
+ * @brief Additional places the update package is downloaded from, from the `PackageSources`
+ *        section of `serviceMainConfig.json`.
+ *
+ * @code
+ * "PackageSources": {
+ *     "SecondaryRegions": [ "Europe" ],
+ *     "Mirrors": [ "\\\\fileserver\\updates", "file:///D:/updates", "https://mirror.example.com/updates" ],
+ *     "Race": true
+ * }
+ * @endcode
+ *
+ * The primary region is always the first source, followed by the secondary regions and the
+ * mirrors in the order given. A mirror is a copy of the storage container: a directory or
+ * URL holding the package as `<customerId>/<siteId>/<blob>` or `<customerId>/<blob>`.
+ * `Race` downloads from the first two sources at once (see `UpdateManager::FetchPackage()`).
+ * A missing or invalid section leaves the primary region as the only source.
+ */
+struct PackageSourcesConfig {
+    std::vector<std::string> secondaryRegions;
+    std::vector<std::string> mirrors;  ///< Base URLs, or file system paths for `file://` and plain paths.
+    bool race = false;
+
+    static PackageSourcesConfig Load(const std::string& configFilePath);
+};
+
+/**
+ * @brief A place the update package can be downloaded from.
+ */
+struct PackageSource {
+    std::string name;                     ///< Shown in logs and the key of the health record.
+    std::vector<std::string> candidates;  ///< Locations of the package to try in order: URLs or file system paths.
+    std::string location;                 ///< The candidate that has the package, set by `URLGenerator::locate()`.
+    HttpResponseHeaders headers;          ///< HEAD response of `location`; empty for file system paths.
+
+    /// Returns true if a location is a URL rather than a file system path.
+    static bool IsUrl(const std::string& location);
+
+    [[nodiscard]] bool IsFile() const { return !location.empty() && !IsUrl(location); }
+};
+
+/**
+ * @class SourceHealth
+ * @brief Remembers which package sources failed recently, so healthy ones are tried first.
+ *
+ * A source that fails is put in a cooldown that doubles with every consecutive failure, from
+ * `kBaseCooldown` up to `kMaxCooldown`. `Order()` moves sources in cooldown behind the others
+ * and otherwise keeps the configured order, so a degraded endpoint costs one timeout rather
+ * than one per cycle, while it is still tried as a last resort. A success ends the cooldown.
+ */
+class SourceHealth {
+public:
+    static SourceHealth& Instance();
+
+    void RecordSuccess(const std::string& source);
+    void RecordFailure(const std::string& source);
+
+    /**
+     * @brief Sorts sources: those in cooldown last, by their number of consecutive failures.
+     */
+    void Order(std::vector<PackageSource>& sources) const;
+
+    SourceHealth(const SourceHealth&) = delete;
+    SourceHealth& operator=(const SourceHealth&) = delete;
+
+private:
+    SourceHealth() = default;
+
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds kBaseCooldown{ 30 };
+    static constexpr std::chrono::seconds kMaxCooldown{ 60 * 60 };
+
+    struct Record {
+        int failures = 0;           ///< Consecutive failures.
+        Clock::time_point retryAt;  ///< End of the cooldown.
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Record> m_records;
+};
+
+#endif // PACKAGESOURCE_H
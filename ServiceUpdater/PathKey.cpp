@@ -0,0 +1,166 @@
+#include "PathKey.h"
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    /// Number of raw spellings remembered before the alias table is cleared.
+    constexpr size_t kMaxAliases = 4096;
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const noexcept {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    /**
+     * @brief Process-wide table of interned keys.
+     *
+     * `keys` owns one copy of each normalized path; its elements never move, so their addresses
+     * serve as handles. `aliases` maps the raw paths seen so far to those handles, so callers
+     * that keep passing the same spelling skip the normalization.
+     */
+    struct Interner {
+        std::mutex mutex;
+        std::unordered_set<std::string, StringHash, std::equal_to<>> keys{ std::string() };
+        std::unordered_map<std::string, const std::string*, StringHash, std::equal_to<>> aliases;
+    };
+
+    Interner& GetInterner() {
+        static Interner interner;
+        return interner;
+    }
+
+    template <typename CharT>
+    bool IsSeparator(CharT c) {
+        return c == CharT('/') || c == CharT('\\');
+    }
+
+    template <typename CharT>
+    CharT FoldCase(CharT c) {
+#ifdef _WIN32
+        if (c >= CharT('A') && c <= CharT('Z')) {
+            return CharT(c - CharT('A') + CharT('a'));
+        }
+#endif
+        return c;
+    }
+
+    /**
+     * @brief Single-pass implementation of `NormalizePath()` for narrow and wide paths.
+     *
+     * Segments are appended to the result as they are read; a `..` truncates the result back
+     * to the previous separator, so no intermediate list of segments is built.
+     */
+    template <typename CharT>
+    std::basic_string<CharT> NormalizeImpl(std::basic_string_view<CharT> path) {
+#ifdef _WIN32
+        constexpr CharT kSeparator = CharT('\\');
+#else
+        constexpr CharT kSeparator = CharT('/');
+#endif
+        constexpr CharT kDot = CharT('.');
+
+        std::basic_string<CharT> result;
+        result.reserve(path.size());
+
+        const size_t size = path.size();
+        size_t i = 0;
+        bool absolute = false;
+        size_t pinnedSegments = 0;
+
+        if (size >= 2 && IsSeparator(path[0]) && IsSeparator(path[1])) {
+            // UNC root: \\server\share, which `..` cannot leave.
+            result.append(2, kSeparator);
+            i = 2;
+            absolute = true;
+            pinnedSegments = 2;
+        }
+        else {
+            if (size >= 2 && path[1] == CharT(':') &&
+                ((path[0] >= CharT('a') && path[0] <= CharT('z')) || (path[0] >= CharT('A') && path[0] <= CharT('Z')))) {
+                result.push_back(FoldCase(path[0]));
+                result.push_back(CharT(':'));
+                i = 2;
+            }
+            if (i < size && IsSeparator(path[i])) {
+                result.push_back(kSeparator);
+                absolute = true;
+            }
+        }
+
+        const size_t rootLength = result.size();
+        size_t segments = 0;
+        size_t leadingParents = 0;
+
+        while (i < size) {
+            while (i < size && IsSeparator(path[i])) {
+                ++i;
+            }
+            size_t end = i;
+            while (end < size && !IsSeparator(path[end])) {
+                ++end;
+            }
+            const size_t length = end - i;
+            const size_t begin = i;
+            i = end;
+
+            if (length == 0 || (length == 1 && path[begin] == kDot)) {
+                continue;
+            }
+
+            if (length == 2 && path[begin] == kDot && path[begin + 1] == kDot) {
+                if (segments > leadingParents && segments > pinnedSegments) {
+                    size_t cut = result.find_last_of(kSeparator);
+                    result.resize(cut == std::basic_string<CharT>::npos || cut < rootLength ? rootLength : cut);
+                    --segments;
+                    continue;
+                }
+                if (absolute) {
+                    continue;
+                }
+                ++leadingParents;
+            }
+
+            if (result.size() > rootLength) {
+                result.push_back(kSeparator);
+            }
+            for (size_t c = begin; c < end; ++c) {
+                result.push_back(FoldCase(path[c]));
+            }
+            ++segments;
+        }
+
+        return result;
+    }
+}
+
+std::string NormalizePath(std::string_view path) {
+    return NormalizeImpl(path);
+}
+
+std::wstring NormalizePath(std::wstring_view path) {
+    return NormalizeImpl(path);
+}
+
+PathKey::PathKey()
+    : m_key(&*GetInterner().keys.find(std::string_view())) {
+}
+
+PathKey PathKey::Intern(std::string_view path) {
+    Interner& interner = GetInterner();
+    std::lock_guard<std::mutex> lock(interner.mutex);
+
+    auto alias = interner.aliases.find(path);
+    if (alias != interner.aliases.end()) {
+        return PathKey(alias->second);
+    }
+
+    const std::string* key = &*interner.keys.insert(NormalizePath(path)).first;
+    if (interner.aliases.size() >= kMaxAliases) {
+        interner.aliases.clear();
+    }
+    interner.aliases.emplace(path, key);
+    return PathKey(key);
+}
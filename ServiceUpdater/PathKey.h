@@ -0,0 +1,66 @@
+#ifndef PATHKEY_H
+#define PATHKEY_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+/**
+ * @brief Normalizes a file path into the form used as a hash store key.
+ *
+ * The path is rewritten in a single pass:
+ * - `/` and `\` are both treated as separators, and runs of them collapse into one native separator.
+ * - `.` segments are dropped.
+ * - `..` segments remove the segment before them; they are kept only at the start of a relative path.
+ * - A trailing separator is dropped.
+ * - On Windows, where paths are case-insensitive, ASCII letters are folded to lower case.
+ *
+ * Drive letters (`C:`) and UNC roots (`\\server\share`) are kept and cannot be left through `..`.
+ * The normalization is purely lexical; the file system is not accessed.
+ *
+ * @param path The path to normalize.
+ * @return The normalized path; normalizing it again does not change it.
+ */
+std::string NormalizePath(std::string_view path);
+std::wstring NormalizePath(std::wstring_view path);
+
+/**
+ * @class PathKey
+ * @brief Interned, normalized file path.
+ *
+ * Every distinct normalized path is stored once for the lifetime of the process, and all keys
+ * of the same path refer to that single copy. Keys therefore compare and hash by address, and
+ * interning a path that was interned before costs one table lookup instead of a normalization.
+ */
+class PathKey {
+public:
+    /// The key of the empty path.
+    PathKey();
+
+    /**
+     * @brief Returns the key of a path, normalizing it with `NormalizePath()` on first use.
+     */
+    static PathKey Intern(std::string_view path);
+
+    [[nodiscard]] const std::string& String() const { return *m_key; }
+    [[nodiscard]] bool Empty() const { return m_key->empty(); }
+
+    bool operator==(const PathKey& other) const { return m_key == other.m_key; }
+    bool operator!=(const PathKey& other) const { return m_key != other.m_key; }
+
+private:
+    explicit PathKey(const std::string* key) : m_key(key) {}
+
+    const std::string* m_key;
+
+    friend struct std::hash<PathKey>;
+};
+
+template <>
+struct std::hash<PathKey> {
+    size_t operator()(const PathKey& key) const noexcept {
+        return std::hash<const std::string*>{}(key.m_key);
+    }
+};
+
+#endif // PATHKEY_H
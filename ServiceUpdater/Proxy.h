@@ -10,6 +10,10 @@
 #include <spdlog/spdlog.h>
 #include "Logger.h"
 #include "DecryptionManager.h"
+#include "CurlPool.h"
+#include "DownloadSink.h"
+#include "TransferLoop.h"
+#include "HashEngine.h"
 
 
 class Proxy {
@@ -34,9 +38,18 @@ public:
         }
     }
 
+    /**
+     * @brief Returns the SHA-256 hash of the last downloaded file, computed during the transfer.
+     */
+    const std::optional<std::string>& getDownloadedSha256() const {
+        return downloaded_sha256;
+    }
+
     bool proxyDownload(const std::string& url, const std::string& destinationPath) {
         LOG_INFO("Starting file download from: {}", url);
 
+        downloaded_sha256.reset();
+
 
         try {
             if (!makeCurlRequestWithProxy(url, destinationPath)) {
@@ -129,18 +142,31 @@ private:
     bool encrypted{ false };
     bool ssl_enabled{ false };
     std::vector<std::string> bypass_list;
+    std::optional<std::string> downloaded_sha256;
+
+    /**
+     * @brief Output file, digest and easy handle of a request, passed to `WriteCallback`.
+     */
+    struct ProxyTransfer {
+        DownloadSink file;
+        DigestStream digest;
+        CURL* curl = nullptr;
+        bool reserved = false;  ///< Whether the space for the body was checked and preallocated.
+    };
 
     /**
      * @brief Callback function for writing data to a file during a CURL request.
      *
-     * This function is used as a write callback by `libcurl` to save the received data into a file.
-     * It ensures valid pointers are provided before writing. If any issue arises (e.g., null pointer
+     * This function is used as a write callback by `libcurl` to save the received data into a file
+     * and add it to the SHA-256 digest of the transfer.
+     * Received data counts against the shared `BandwidthLimiter`, which may pause the transfer to
+     * keep the configured download rate. It ensures valid pointers are provided before writing. If any issue arises (e.g., null pointer
      * or file not open), it logs the error and returns `0` to indicate failure.
      *
      * @param contents Pointer to the downloaded data.
      * @param size Size of a single data unit.
      * @param nmemb Number of data units.
-     * @param userp Pointer to the file stream where data should be written.
+     * @param userp Pointer to the `ProxyTransfer` of the request.
      * @return The number of bytes successfully written, or `0` on failure.
      */
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
@@ -150,13 +176,28 @@ private:
             return 0;
         }
 
-        std::ofstream* file = static_cast<std::ofstream*>(userp);
-        if (!file->is_open()) {
+        ProxyTransfer* transfer = static_cast<ProxyTransfer*>(userp);
+        if (TransferLoop::Instance().PauseForBandwidth(transfer->curl, size * nmemb)) {
+            return CURL_WRITEFUNC_PAUSE;
+        }
+        if (!transfer->file.IsOpen()) {
             LOG_ERROR("WriteCallback: File is not open for writing.");
 
             return 0;
         }
-        file->write(static_cast<const char*>(contents), size * nmemb);
+        if (!transfer->reserved) {
+            // Check the space and preallocate the file once the length of the body is known
+            transfer->reserved = true;
+            curl_off_t length = -1;
+            if (curl_easy_getinfo(transfer->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK &&
+                length > 0 && !transfer->file.Reserve(static_cast<uint64_t>(length))) {
+                return 0;
+            }
+        }
+        if (!transfer->file.Write(contents, size * nmemb)) {
+            return 0;
+        }
+        transfer->digest.Update(contents, size * nmemb);
         return size * nmemb;
     }
     /**
@@ -169,25 +210,30 @@ private:
      * The function logs all key details, including whether SSL verification is enabled, proxy details,
      * and potential errors encountered during the request.
      *
+     * The easy handle comes from the shared `CurlPool`, so connections and TLS sessions are
+     * reused across requests. The request runs on the `TransferLoop`, so stopping the service
+     * aborts it.
+     *
      * @param url The URL to request.
      * @param proxy The proxy server address, or an empty string if no proxy is used.
      * @param output_file The path where the response should be saved.
      * @return true if the request was successful and the file was downloaded, false otherwise.
      */
     bool makeCurlRequest(const std::string& url, const std::string& proxy, const std::string& output_file) {
-        CURL* curl = curl_easy_init(); 
+        CurlHandle handle = CurlPool::Instance().Acquire();
+        CURL* curl = handle.get();
         CURLcode res;
         long response_code = 0;
         struct curl_slist* headers = nullptr;
 
         if (!curl) {
-            LOG_ERROR("Failed to initialize CURL.");
             return false;
         }
 
         try {
-            std::ofstream file(output_file, std::ios::binary);
-            if (!file.is_open()) {
+            ProxyTransfer transfer;
+            transfer.curl = curl;
+            if (!transfer.file.Open(output_file, 0, true)) {
                 LOG_ERROR("Failed to open file for writing: {}", output_file);
                 throw std::runtime_error("Failed to open output file");
             }
@@ -263,10 +309,10 @@ private:
 
 
             curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &file);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
             curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 
-            res = curl_easy_perform(curl);
+            res = TransferLoop::Instance().Perform(curl).get();
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
 
             if (res != CURLE_OK) {
@@ -277,8 +323,14 @@ private:
                 throw std::runtime_error("HTTP request failed with status: " + std::to_string(response_code));
             }
 
+            if (!transfer.file.Close(true)) {
+                throw std::runtime_error("Failed to write " + output_file);
+            }
+            downloaded_sha256 = transfer.digest.Finish();
+
             LOG_INFO("File successfully downloaded: {}", output_file);
 
+            curl_slist_free_all(headers);
             return true;
         }
         catch (const std::exception& e) {
@@ -291,7 +343,6 @@ private:
         if (headers) {
             curl_slist_free_all(headers);
         }
-        curl_easy_cleanup(curl);
 
         return false;
     }
@@ -0,0 +1,79 @@
+#include "RetryPolicy.h"
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <random>
+
+namespace {
+    std::mt19937_64& Random() {
+        thread_local std::mt19937_64 random(std::random_device{}());
+        return random;
+    }
+}
+
+bool RetryPolicy::IsRetryable(CURLcode res, long responseCode) {
+    switch (res) {
+    case CURLE_OK:
+    case CURLE_HTTP_RETURNED_ERROR:
+        return responseCode == 408 || responseCode == 429 ||
+            (responseCode >= 500 && responseCode <= 599 && responseCode != 501 && responseCode != 505);
+    case CURLE_COULDNT_RESOLVE_PROXY:
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_HTTP2:
+    case CURLE_HTTP2_STREAM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<std::chrono::milliseconds> RetryPolicy::RetryAfter(const HttpResponseHeaders& headers) {
+    auto value = headers.Get("Retry-After");
+    if (!value || value->empty()) {
+        return std::nullopt;
+    }
+
+    long long seconds = 0;
+    auto [end, ec] = std::from_chars(value->data(), value->data() + value->size(), seconds);
+    if (ec == std::errc() && end == value->data() + value->size()) {
+        return std::chrono::seconds(std::max(seconds, 0LL));
+    }
+
+    time_t date = curl_getdate(value->c_str(), nullptr);
+    if (date == -1) {
+        return std::nullopt;
+    }
+    return std::chrono::seconds(std::max<long long>(date - std::time(nullptr), 0));
+}
+
+std::optional<std::chrono::milliseconds> RetryPolicy::NextDelay(int failures, Clock::time_point started,
+    std::optional<std::chrono::milliseconds> retryAfter) const {
+    if (failures >= maxAttempts) {
+        return std::nullopt;
+    }
+
+    // The ceiling doubles with every failure: base, 2 * base, 4 * base, ... up to maxDelay.
+    std::chrono::milliseconds ceiling = maxDelay;
+    const int doublings = std::max(failures - 1, 0);
+    if (doublings < 31 && baseDelay.count() <= (maxDelay.count() >> doublings)) {
+        ceiling = baseDelay * (1LL << doublings);
+    }
+
+    std::uniform_int_distribution<long long> jitter(0, ceiling.count());
+    std::chrono::milliseconds delay(jitter(Random()));
+    if (retryAfter) {
+        delay = std::max(delay, *retryAfter);
+    }
+
+    if (Clock::now() + delay - started > maxElapsed) {
+        return std::nullopt;
+    }
+    return delay;
+}
@@ -0,0 +1,68 @@
+#ifndef RETRYPOLICY_H
+#define RETRYPOLICY_H
+
+#include <curl/curl.h>
+#include <chrono>
+#include <optional>
+#include "HttpHeaders.h"
+
+/**
+ * @class RetryPolicy
+ * @brief Decides whether a failed transfer is retried and how long to wait before it.
+ *
+ * Delays grow exponentially from `baseDelay` up to `maxDelay` and are drawn uniformly
+ * from `[0, delay]` ("full jitter"), so sites that start their updates at the same time
+ * do not retry in lockstep. A `Retry-After` sent by the server is honored as the lower
+ * bound of the delay. Retrying stops after `maxAttempts` attempts or once the next retry
+ * would start later than `maxElapsed` after the first attempt.
+ */
+class RetryPolicy {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RetryPolicy(int maxAttempts = 3,
+        std::chrono::milliseconds baseDelay = std::chrono::seconds(2),
+        std::chrono::milliseconds maxDelay = std::chrono::minutes(2),
+        std::chrono::milliseconds maxElapsed = std::chrono::minutes(30))
+        : maxAttempts(maxAttempts), baseDelay(baseDelay), maxDelay(maxDelay), maxElapsed(maxElapsed) {
+    }
+
+    /**
+     * @brief Returns whether a failure is transient and worth another attempt.
+     *
+     * Connection, DNS, TLS handshake and timeout errors, dropped transfers, 408, 429 and
+     * 5xx responses (except 501 and 505) are transient. Local errors such as a failed
+     * write and other 4xx responses are not.
+     *
+     * @param res Result of the transfer.
+     * @param responseCode HTTP status of the response, or 0 if none was received.
+     */
+    [[nodiscard]] static bool IsRetryable(CURLcode res, long responseCode);
+
+    /**
+     * @brief Returns the delay requested by a `Retry-After` header, if the response has one.
+     *
+     * Both forms of the header are accepted: a number of seconds and an HTTP date.
+     */
+    [[nodiscard]] static std::optional<std::chrono::milliseconds> RetryAfter(const HttpResponseHeaders& headers);
+
+    /**
+     * @brief Returns how long to wait before the next attempt, or nothing to give up.
+     *
+     * @param failures Number of failed attempts so far, including the one just made.
+     * @param started When the first attempt started.
+     * @param retryAfter Delay requested by the server, if any.
+     */
+    [[nodiscard]] std::optional<std::chrono::milliseconds> NextDelay(int failures, Clock::time_point started,
+        std::optional<std::chrono::milliseconds> retryAfter = std::nullopt) const;
+
+    [[nodiscard]] int MaxAttempts() const { return maxAttempts; }
+
+private:
+    int maxAttempts;
+    std::chrono::milliseconds baseDelay;
+    std::chrono::milliseconds maxDelay;
+    std::chrono::milliseconds maxElapsed;
+};
+
+#endif // RETRYPOLICY_H
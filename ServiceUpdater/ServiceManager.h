@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <spdlog/spdlog.h>
 #include <vector>
+#include <optional>
 #include <string>
 
 namespace fs = std::filesystem;
@@ -30,9 +31,12 @@ public:
      * @param serviceName The name of the service to be managed.
      * @param exePath The path to the service's executable file.
      * @param args A list of arguments for service installation.
+     * @param serviceHasher Hasher of the service hash store to record the new executable's hash
+     *        with, so it joins the caller's batch; if null, the hash is recorded on its own.
      */
-    ServiceManager(const std::wstring& serviceName, const std::wstring& exePath, const std::vector<std::wstring>& args = {})
-        : m_serviceName(serviceName), m_exePath(exePath), m_args(args) {
+    ServiceManager(const std::wstring& serviceName, const std::wstring& exePath, const std::vector<std::wstring>& args = {},
+        FileHasher* serviceHasher = nullptr)
+        : m_serviceName(serviceName), m_exePath(exePath), m_args(args), m_serviceHasher(serviceHasher) {
     }
 
     /**
@@ -80,8 +84,11 @@ public:
 
             UpgradePathManager pathManager;
 
-            std::string serviceJson = pathManager.GetServiceHashFilePath();
-            FileHasher hasher(serviceJson);
+            std::optional<FileHasher> ownHasher;
+            if (!m_serviceHasher) {
+                ownHasher.emplace(pathManager.GetServiceHashFilePath());
+            }
+            FileHasher& hasher = m_serviceHasher ? *m_serviceHasher : *ownHasher;
 
             std::wstring exe1 = pathManager.GetService1TargetPath();
             std::wstring exe2 = pathManager.GetService2TargetPath();
@@ -156,6 +163,7 @@ private:
     std::wstring m_serviceName;  ///< The name of the service being managed.
     std::wstring m_exePath;      ///< The path to the service executable.
     std::vector<std::wstring> m_args;  ///< The list of installation arguments.
+    FileHasher* m_serviceHasher;  ///< Hasher to record the new executable's hash with, or null.
 
     /**
      * @brief Uninstalls the service using the `uninstall` command.
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <filesystem>
 #include <cassert>
+#include <fstream>
 #include <windows.h>
 #include "MainService.h"
 #include "Logger.h"
+#include "HashBenchmark.h"
 
 namespace fs = std::filesystem;
 
@@ -364,10 +366,88 @@ int main(int argc, char* argv[]) {
                 // Uninstall the service
                 FullUninstallService();
             }
+            else if (arg == "dump_hashes") {
+                // Print a hash store as JSON for inspection
+                Logger::Init();
+                if (argc < 3) {
+                    spdlog::error("Missing hash store path.");
+                    spdlog::info("Usage: ServiceUpdater.exe dump_hashes <store.hashdb> [<output.json>]");
+                    return 1;
+                }
+
+                if (argc > 3) {
+                    std::ofstream out(argv[3]);
+                    if (!out.is_open()) {
+                        spdlog::error("Failed to open output file: {}", argv[3]);
+                        return 1;
+                    }
+                    HashStore::DumpFile(argv[2], out);
+                }
+                else {
+                    HashStore::DumpFile(argv[2], std::cout);
+                }
+            }
+            else if (arg == "migrate_hashes") {
+                // Convert JSON hash files to the binary store format (the default stores if no path is given)
+                Logger::Init();
+                std::vector<std::string> storePaths(argv + 2, argv + argc);
+                if (storePaths.empty()) {
+                    UpgradePathManager path;
+                    storePaths = { path.GetZipHashFilePath(), path.GetServiceHashFilePath() };
+                }
+
+                for (const auto& storePath : storePaths) {
+                    auto store = HashStore::Open(storePath);
+                    spdlog::info("Hash store '{}' holds {} records.", store->GetPath(), store->Size());
+                }
+            }
+            else if (arg == "bench_hashes") {
+                // Measure file hashing and hash store performance, results as JSON
+                Logger::Init();
+                HashBenchmarkOptions options;
+                std::string outputPath;
+                for (int i = 2; i < argc; ++i) {
+                    std::string option = argv[i];
+                    bool hasValue = i + 1 < argc;
+                    if (option == "--dir" && hasValue) {
+                        options.workDirectory = argv[++i];
+                    }
+                    else if (option == "--max-size" && hasValue) {
+                        options.maxFileSize = std::stoull(argv[++i]);
+                    }
+                    else if (option == "--entries" && hasValue) {
+                        options.maxStoreEntries = static_cast<size_t>(std::stoull(argv[++i]));
+                    }
+                    else if (option == "--repetitions" && hasValue) {
+                        options.repetitions = std::stoi(argv[++i]);
+                    }
+                    else if (outputPath.empty() && option.rfind("--", 0) != 0) {
+                        outputPath = option;
+                    }
+                    else {
+                        spdlog::error("Invalid option '{}'.", option);
+                        spdlog::info("Usage: ServiceUpdater.exe bench_hashes [<output.json>] [--dir <path>] [--max-size <bytes>] [--entries <n>] [--repetitions <n>]");
+                        return 1;
+                    }
+                }
+
+                json results = HashBenchmark(options).Run();
+                if (!outputPath.empty()) {
+                    std::ofstream out(outputPath);
+                    if (!out.is_open()) {
+                        spdlog::error("Failed to open output file: {}", outputPath);
+                        return 1;
+                    }
+                    out << results.dump(4) << std::endl;
+                }
+                else {
+                    std::cout << results.dump(4) << std::endl;
+                }
+            }
             else {
                 // Handle unknown command
                 spdlog::error("Unknown command '{}'.", arg);
-                spdlog::info("Usage: ServiceUpdater.exe install|uninstall|uninstall_all");
+                spdlog::info("Usage: ServiceUpdater.exe install|uninstall|uninstall_all|dump_hashes|migrate_hashes|bench_hashes");
                 return 1;
             }
 
@@ -56,11 +56,15 @@ public:
             m_fullReinstall = m_updateManager.NeedsFullReinstall();
 
             bool updatePerformed = false;
+            m_serviceFileHasher.BeginBatch();
             for (const auto& [serviceName, exePath, newExeName] : m_services) {
                 if (CompareAndUpdateService(exePath, newExeName, serviceName)) {
                     updatePerformed = true;
                 }
             }
+            if (!m_serviceFileHasher.Commit()) {
+                LOG_ERROR("Failed to record service hashes in '{}'", m_serviceHashFile);
+            }
 
             if (updatePerformed) {
                 LOG_INFO("Service upgrade completed successfully.");
@@ -167,7 +171,7 @@ private:
 
                 std::vector<std::wstring> args = (serviceName == L"DCSStreamingAgentWatchdog") ? std::vector<std::wstring>{} : GenerateServiceArguments();
 
-                ServiceManager serviceManager(serviceName, newExePath, args);
+                ServiceManager serviceManager(serviceName, newExePath, args, &m_serviceFileHasher);
                 return serviceManager.UpdateService();
             }
             else {
@@ -178,8 +182,7 @@ private:
         }
 
         if (!m_serviceFileHasher.CheckAndUpdateFileHash(ConvertWStringToString(targetExePath),
-            ConvertWStringToString(newExePath),
-            m_serviceHashFile)) {
+            ConvertWStringToString(newExePath))) {
             LOG_INFO("No update required for '{}'.", ConvertWStringToString(targetExePath));
 
             return false;
@@ -193,7 +196,7 @@ private:
 
             std::vector<std::wstring> args = (serviceName == L"DCSStreamingAgentWatchdog") ? std::vector<std::wstring>{} : GenerateServiceArguments();
 
-            ServiceManager serviceManager(serviceName, newExePath, args);
+            ServiceManager serviceManager(serviceName, newExePath, args, &m_serviceFileHasher);
             return serviceManager.UpdateService();
         }
         else {
@@ -0,0 +1,519 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "SiteCache.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "DownloadSink.h"
+#include "Logger.h"
+
+using json = nlohmann::json;
+
+namespace {
+#ifdef _WIN32
+    using NativeSocket = SOCKET;
+    constexpr int kShutdownBoth = SD_BOTH;
+    constexpr int kSendFlags = 0;
+#else
+    using NativeSocket = int;
+    constexpr int kShutdownBoth = SHUT_RDWR;
+    constexpr int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+    /// Name of the file recording the current package in the cache directory.
+    constexpr const char* kIndexFileName = "package.json";
+    /// Size of the chunks a package is copied and sent in.
+    constexpr size_t kChunkSize = 1024 * 1024;
+
+    std::string ToLower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    SiteCacheRole ParseRole(const std::string& value) {
+        const std::string role = ToLower(value);
+        if (role == "off") {
+            return SiteCacheRole::Off;
+        }
+        if (role == "server") {
+            return SiteCacheRole::Server;
+        }
+        if (role == "client") {
+            return SiteCacheRole::Client;
+        }
+        throw std::runtime_error("Invalid role '" + value + "', expected Off, Server or Client.");
+    }
+
+    void SetIoTimeout(NativeSocket socket, int seconds) {
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(seconds) * 1000;
+#else
+        timeval timeout{ seconds, 0 };
+#endif
+        setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+}
+
+SiteCacheConfig SiteCacheConfig::Load(const std::string& configFilePath) {
+    try {
+        std::ifstream file(configFilePath);
+        if (!file.is_open()) {
+            return {};
+        }
+
+        json config = json::parse(file);
+        if (!config.contains("SiteCache")) {
+            return {};
+        }
+
+        const json& section = config["SiteCache"];
+        SiteCacheConfig result;
+        result.role = ParseRole(section.value("Role", std::string("Off")));
+        result.port = section.value("Port", kDefaultPort);
+        result.bindAddress = section.value("BindAddress", result.bindAddress);
+        result.serverUrl = section.value("Server", std::string());
+        while (!result.serverUrl.empty() && result.serverUrl.back() == '/') {
+            result.serverUrl.pop_back();
+        }
+        if (result.role == SiteCacheRole::Client && result.serverUrl.empty()) {
+            throw std::runtime_error("the Client role requires 'Server'");
+        }
+        return result;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Invalid 'SiteCache' in '{}' ({}); the site cache is off.", configFilePath, e.what());
+
+        return {};
+    }
+}
+
+std::string SiteCacheConfig::PackageUrl(const ContentFingerprint& fingerprint) const {
+    std::optional<std::string> md5 = HashEngine::Base64ToHex(fingerprint.md5);
+    if (serverUrl.empty() || !md5) {
+        return "";
+    }
+    return serverUrl + "/packages/" + *md5;
+}
+
+SiteCacheServer& SiteCacheServer::Instance() {
+    static SiteCacheServer server;
+    return server;
+}
+
+SiteCacheServer::~SiteCacheServer() {
+    Stop();
+}
+
+bool SiteCacheServer::Start(const SiteCacheConfig& config, const fs::path& directory) {
+    std::lock_guard<std::mutex> lifecycle(m_lifecycleMutex);
+    if (m_running) {
+        return true;
+    }
+
+    try {
+        fs::create_directories(directory);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Failed to create the site cache directory {}: {}", directory.string(), e.what());
+
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_directory = directory;
+    }
+    LoadCurrent();
+
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        LOG_ERROR("Failed to initialize Winsock for the site cache.");
+
+        return false;
+    }
+#endif
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    Socket listener = static_cast<Socket>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (listener == kInvalidSocket || inet_pton(AF_INET, config.bindAddress.c_str(), &address.sin_addr) != 1) {
+        LOG_ERROR("Failed to create the site cache socket for {}:{}.", config.bindAddress, config.port);
+
+        CloseSocket(listener);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    int enable = 1;
+#ifdef _WIN32
+    // Keeps other processes from binding the same port while the service listens on it.
+    setsockopt(static_cast<NativeSocket>(listener), SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&enable), sizeof(enable));
+#else
+    setsockopt(static_cast<NativeSocket>(listener), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+#endif
+    if (bind(static_cast<NativeSocket>(listener), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(static_cast<NativeSocket>(listener), SOMAXCONN) != 0) {
+        LOG_ERROR("The site cache failed to listen on {}:{}.", config.bindAddress, config.port);
+
+        CloseSocket(listener);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    m_listener = listener;
+    m_running = true;
+    m_acceptThread = std::thread(&SiteCacheServer::AcceptLoop, this);
+    LOG_INFO("Site cache listening on {}:{}, serving from {}.", config.bindAddress, config.port, directory.string());
+
+    return true;
+}
+
+void SiteCacheServer::Stop() {
+    std::lock_guard<std::mutex> lifecycle(m_lifecycleMutex);
+    if (!m_running) {
+        return;
+    }
+
+    m_running = false;
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+    CloseSocket(m_listener);
+    m_listener = kInvalidSocket;
+
+    // Shutting the sockets down makes every blocked recv() and send() return, so the joins are quick
+    std::list<Connection> connections;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Connection& connection : m_connections) {
+            if (connection.socket != kInvalidSocket) {
+                shutdown(static_cast<NativeSocket>(connection.socket), kShutdownBoth);
+            }
+        }
+        connections.swap(m_connections);
+    }
+    for (Connection& connection : connections) {
+        connection.thread.join();
+    }
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    LOG_INFO("Site cache stopped.");
+}
+
+bool SiteCacheServer::Publish(const fs::path& packageFile, const ContentFingerprint& fingerprint) {
+    return Store([&packageFile](const HashEngine::ChunkConsumer& consumer) {
+        ReadOptions options;
+        options.strategy = ReadStrategy::BufferedRead;
+        options.strideSize = kChunkSize;
+        return HashEngine::ForEachChunk(packageFile, consumer, options);
+    }, fingerprint);
+}
+
+bool SiteCacheServer::Publish(const std::string& content, const ContentFingerprint& fingerprint) {
+    return Store([&content](const HashEngine::ChunkConsumer& consumer) {
+        return consumer(reinterpret_cast<const unsigned char*>(content.data()), content.size());
+    }, fingerprint);
+}
+
+bool SiteCacheServer::Store(const PackageSource& source, const ContentFingerprint& fingerprint) {
+    std::optional<std::string> md5 = HashEngine::Base64ToHex(fingerprint.md5);
+    if (!md5 || !fingerprint.length) {
+        LOG_WARN("The cloud reported no usable MD5 and length for the package; it is not shared with the site.");
+
+        return false;
+    }
+
+    fs::path directory;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_directory.empty()) {
+            return false;
+        }
+        if (m_current && m_current->md5 == *md5) {
+            return true;
+        }
+        directory = m_directory;
+    }
+
+    const fs::path tempFile = directory / (*md5 + ".zip.tmp");
+    DownloadSink sink;
+    DigestStream digest(EVP_md5());
+    if (!sink.Open(tempFile, 0, true)) {
+        return false;
+    }
+    sink.Reserve(fingerprint.length);
+
+    const bool copied = source([&](const unsigned char* data, size_t size) {
+        digest.Update(data, size);
+        return sink.Write(data, size);
+    });
+    const bool closed = sink.Close(true);
+    const std::optional<std::string> actual = digest.Finish();
+    if (!copied || !closed || actual != md5 || digest.Bytes() != fingerprint.length) {
+        LOG_ERROR("The package does not match the MD5 and length the cloud reported ({}, {} bytes); it is not shared with the site.",
+            *md5, fingerprint.length);
+
+        std::error_code ec;
+        fs::remove(tempFile, ec);
+        return false;
+    }
+    return Commit(tempFile, *md5, fingerprint.length);
+}
+
+bool SiteCacheServer::Commit(const fs::path& tempFile, const std::string& md5, uint64_t length) {
+    const fs::path directory = tempFile.parent_path();
+    const fs::path packageFile = directory / (md5 + ".zip");
+    const fs::path indexFile = directory / kIndexFileName;
+    const fs::path indexTempFile = directory / (std::string(kIndexFileName) + ".tmp");
+
+    try {
+        fs::rename(tempFile, packageFile);
+        {
+            std::ofstream index(indexTempFile, std::ios::trunc);
+            index << json{ { "md5", md5 }, { "length", length } }.dump(4);
+            if (!index) {
+                throw std::runtime_error("failed to write " + indexTempFile.string());
+            }
+        }
+        fs::rename(indexTempFile, indexFile);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Failed to store the package in the site cache: {}", e.what());
+
+        std::error_code ec;
+        fs::remove(tempFile, ec);
+        fs::remove(indexTempFile, ec);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_current = CachedPackage{ md5, length, packageFile };
+    }
+
+    // Older packages may still be in use by a connection; they are removed on the next publish then.
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        if (entry.path().extension() == ".zip" && entry.path() != packageFile) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    LOG_INFO("Site cache now serves package {} ({} bytes).", md5, length);
+
+    return true;
+}
+
+void SiteCacheServer::LoadCurrent() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current.reset();
+
+    try {
+        std::ifstream file(m_directory / kIndexFileName);
+        if (!file.is_open()) {
+            return;
+        }
+
+        json index = json::parse(file);
+        CachedPackage package;
+        package.md5 = index.at("md5").get<std::string>();
+        package.length = index.at("length").get<uint64_t>();
+        package.path = m_directory / (package.md5 + ".zip");
+
+        std::error_code ec;
+        if (fs::file_size(package.path, ec) != package.length || ec) {
+            LOG_WARN("The site cache package {} is missing or incomplete; nothing is served until the next update.", package.md5);
+
+            return;
+        }
+        m_current = package;
+        LOG_INFO("Site cache serves package {} ({} bytes) from an earlier run.", package.md5, package.length);
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Failed to read the site cache index: {}", e.what());
+    }
+}
+
+void SiteCacheServer::AcceptLoop() {
+    const NativeSocket listener = static_cast<NativeSocket>(m_listener);
+    while (m_running) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        timeval timeout{ 1, 0 };
+        if (select(static_cast<int>(listener) + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+
+        const Socket client = static_cast<Socket>(accept(listener, nullptr, nullptr));
+        if (client == kInvalidSocket) {
+            continue;
+        }
+        SetIoTimeout(static_cast<NativeSocket>(client), kIoTimeoutSeconds);
+
+        if (ReapConnections() >= kMaxConnections) {
+            SendStatus(client, 503, "Service Unavailable");
+            CloseSocket(client);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Connection& connection = m_connections.emplace_back();
+        connection.socket = client;
+        connection.thread = std::thread([this, &connection] {
+            HandleConnection(connection.socket);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                CloseSocket(connection.socket);
+                connection.socket = kInvalidSocket;
+            }
+            connection.finished = true;
+        });
+    }
+}
+
+size_t SiteCacheServer::ReapConnections() {
+    std::list<Connection> finished;
+    size_t open = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_connections.begin(); it != m_connections.end();) {
+            auto next = std::next(it);
+            if (it->finished) {
+                finished.splice(finished.end(), m_connections, it);
+            }
+            it = next;
+        }
+        open = m_connections.size();
+    }
+    for (Connection& connection : finished) {
+        connection.thread.join();
+    }
+    return open;
+}
+
+void SiteCacheServer::HandleConnection(Socket client) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        if (request.size() > kMaxRequestSize) {
+            SendStatus(client, 400, "Bad Request");
+            return;
+        }
+        const int received = recv(static_cast<NativeSocket>(client), buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    std::istringstream requestLine(request.substr(0, request.find("\r\n")));
+    std::string method;
+    std::string target;
+    requestLine >> method >> target;
+    if (method != "GET" && method != "HEAD") {
+        SendStatus(client, 405, "Method Not Allowed");
+        return;
+    }
+
+    std::optional<CachedPackage> package;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        package = m_current;
+    }
+    if (!package || target != "/packages/" + package->md5) {
+        LOG_INFO("Site cache: {} {} not found.", method, target);
+
+        SendStatus(client, 404, "Not Found");
+        return;
+    }
+    SendPackage(client, method == "HEAD", *package);
+}
+
+bool SiteCacheServer::SendPackage(Socket client, bool headOnly, const CachedPackage& package) {
+    const std::string head =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/zip\r\n"
+        "Content-Length: " + std::to_string(package.length) + "\r\n"
+        "ETag: \"" + package.md5 + "\"\r\n"
+        "Connection: close\r\n\r\n";
+    if (!SendAll(client, head.data(), head.size())) {
+        return false;
+    }
+    if (headOnly) {
+        return true;
+    }
+
+    ReadOptions options;
+    options.strategy = ReadStrategy::BufferedRead;
+    options.strideSize = kChunkSize;
+    uint64_t sent = 0;
+    const bool complete = HashEngine::ForEachChunk(package.path, [&](const unsigned char* data, size_t size) {
+        if (!SendAll(client, data, size)) {
+            return false;
+        }
+        sent += size;
+        return true;
+    }, options);
+
+    if (!complete || sent != package.length) {
+        LOG_WARN("Site cache: transfer of package {} ended after {} of {} bytes.", package.md5, sent, package.length);
+
+        return false;
+    }
+    LOG_INFO("Site cache: served package {} ({} bytes).", package.md5, sent);
+
+    return true;
+}
+
+bool SiteCacheServer::SendAll(Socket client, const void* data, size_t size) {
+    const char* next = static_cast<const char*>(data);
+    while (size > 0) {
+        const int chunk = static_cast<int>(std::min<size_t>(size, kChunkSize));
+        const int sent = send(static_cast<NativeSocket>(client), next, chunk, kSendFlags);
+        if (sent <= 0) {
+            return false;
+        }
+        next += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool SiteCacheServer::SendStatus(Socket client, int status, const char* reason) {
+    const std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n\r\n";
+    return SendAll(client, response.data(), response.size());
+}
+
+void SiteCacheServer::CloseSocket(Socket socket) {
+    if (socket == kInvalidSocket) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket(static_cast<NativeSocket>(socket));
+#else
+    close(static_cast<NativeSocket>(socket));
+#endif
+}
@@ -0,0 +1,172 @@
+#ifndef SITECACHE_H
+#define SITECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include "HttpHeaders.h"
+#include "HashEngine.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Part a node plays in sharing update packages within a site.
+ */
+enum class SiteCacheRole {
+    Off,     ///< Download from the cloud only.
+    Server,  ///< Download from the cloud and serve verified packages to the other nodes.
+    Client   ///< Try the site cache first, then the cloud.
+};
+
+/**
+ * @brief Site cache settings from the `SiteCache` section of `serviceMainConfig.json`.
+ *
+ * @code
+ * "SiteCache": { "Role": "Server", "Port": 8790 }
+ * "SiteCache": { "Role": "Client", "Server": "http://10.1.2.3:8790" }
+ * @endcode
+ *
+ * A missing or invalid section turns the site cache off.
+ */
+struct SiteCacheConfig {
+    static constexpr uint16_t kDefaultPort = 8790;
+
+    SiteCacheRole role = SiteCacheRole::Off;
+    uint16_t port = kDefaultPort;         ///< Port the server listens on.
+    std::string bindAddress = "0.0.0.0";  ///< IPv4 address the server listens on (`BindAddress`).
+    std::string serverUrl;                ///< Base URL of the site cache, for clients.
+
+    static SiteCacheConfig Load(const std::string& configFilePath);
+
+    /**
+     * @brief Returns the URL of the package with the given fingerprint on the site cache.
+     *
+     * Packages are addressed by the MD5 the cloud reported for them, so a client never
+     * receives a package other than the one it asked for.
+     *
+     * @return The URL, or an empty string if there is no server URL or no valid MD5.
+     */
+    [[nodiscard]] std::string PackageUrl(const ContentFingerprint& fingerprint) const;
+};
+
+/**
+ * @class SiteCacheServer
+ * @brief Minimal HTTP server that hands the last verified update package to the nodes of a site.
+ *
+ * One node per site runs the server; after it has downloaded a package and verified it
+ * against the MD5 and length the cloud reported, `Publish()` stores a copy under
+ * `sitecache\` and the other nodes download it with `GET /packages/<md5 in hex>` instead
+ * of from the cloud. Only the current package is kept and served; any other path is a 404.
+ * Clients verify the package against the cloud fingerprint themselves, so the server is
+ * not trusted beyond availability.
+ *
+ * Every connection serves one request (`Connection: close`) on a thread of its own. At most
+ * `kMaxConnections` are served at once; further connections get a 503 and are closed, so
+ * hosts on the LAN cannot exhaust the threads and sockets of the service. `Stop()` joins
+ * every connection thread. The cached package survives restarts of the service.
+ */
+class SiteCacheServer {
+public:
+    static SiteCacheServer& Instance();
+
+    /**
+     * @brief Starts listening for requests.
+     *
+     * @param config Port and address to listen on.
+     * @param directory Directory holding the cached package.
+     * @return true if the server is listening.
+     */
+    bool Start(const SiteCacheConfig& config, const fs::path& directory);
+
+    /**
+     * @brief Stops listening and closes all open connections.
+     */
+    void Stop();
+
+    [[nodiscard]] bool IsRunning() const { return m_running; }
+
+    /**
+     * @brief Verifies a downloaded package file and makes it the package served to the site.
+     *
+     * @param packageFile The downloaded package.
+     * @param fingerprint MD5 and length the cloud reported for the package.
+     * @return true if the package is now served, false if it could not be verified or stored.
+     */
+    bool Publish(const fs::path& packageFile, const ContentFingerprint& fingerprint);
+
+    /**
+     * @brief Verifies a package downloaded into memory and makes it the package served to the site.
+     */
+    bool Publish(const std::string& content, const ContentFingerprint& fingerprint);
+
+    SiteCacheServer(const SiteCacheServer&) = delete;
+    SiteCacheServer& operator=(const SiteCacheServer&) = delete;
+
+private:
+    SiteCacheServer() = default;
+    ~SiteCacheServer();
+
+    /// Socket handle; a `SOCKET` on Windows, a file descriptor elsewhere.
+    using Socket = uintptr_t;
+    static constexpr Socket kInvalidSocket = ~Socket{ 0 };
+
+    /// Longest time a connection may wait for the client before it is dropped.
+    static constexpr int kIoTimeoutSeconds = 30;
+    /// Largest request head accepted.
+    static constexpr size_t kMaxRequestSize = 8 * 1024;
+    /// Largest number of connections served at once.
+    static constexpr size_t kMaxConnections = 16;
+
+    /// A connection being served and the thread serving it.
+    struct Connection {
+        Socket socket = kInvalidSocket;  ///< Closed and reset by the thread once it is done, under `m_mutex`.
+        std::thread thread;
+        std::atomic<bool> finished{ false };
+    };
+
+    struct CachedPackage {
+        std::string md5;  ///< MD5 in hex, also the name of the file in the cache directory.
+        uint64_t length = 0;
+        fs::path path;
+    };
+
+    /// Feeds the content of a package to a consumer, chunk by chunk.
+    using PackageSource = std::function<bool(const HashEngine::ChunkConsumer& consumer)>;
+
+    /// Copies a package into the cache directory, verifying it against the cloud fingerprint on the way.
+    bool Store(const PackageSource& source, const ContentFingerprint& fingerprint);
+
+    /// Makes a verified file in the cache directory the current package and removes older ones.
+    bool Commit(const fs::path& tempFile, const std::string& md5, uint64_t length);
+
+    /// Loads the package recorded in the cache directory by an earlier run.
+    void LoadCurrent();
+
+    void AcceptLoop();
+
+    /// Joins the threads of finished connections and returns the number still open.
+    size_t ReapConnections();
+    void HandleConnection(Socket client);
+    bool SendPackage(Socket client, bool headOnly, const CachedPackage& package);
+    static bool SendAll(Socket client, const void* data, size_t size);
+    static bool SendStatus(Socket client, int status, const char* reason);
+    static void CloseSocket(Socket socket);
+
+    mutable std::mutex m_mutex;
+    fs::path m_directory;
+    std::optional<CachedPackage> m_current;
+    std::list<Connection> m_connections;
+
+    std::mutex m_lifecycleMutex;
+    std::atomic<bool> m_running{ false };
+    Socket m_listener = kInvalidSocket;
+    std::thread m_acceptThread;
+};
+
+#endif // SITECACHE_H
@@ -0,0 +1,196 @@
+#include "TransferLoop.h"
+#include <algorithm>
+#include "BandwidthLimiter.h"
+#include "CurlPool.h"
+#include "Logger.h"
+
+namespace {
+    /// Longest time an idle loop sleeps; new transfers and `AbortAll()` wake it up at once.
+    constexpr int kIdleTimeoutMs = 60 * 1000;
+}
+
+TransferLoop& TransferLoop::Instance() {
+    static TransferLoop loop;
+    return loop;
+}
+
+TransferLoop::TransferLoop() {
+    // The pool performs curl_global_init(); creating it first also destroys it after the loop.
+    CurlPool::Instance();
+}
+
+TransferLoop::~TransferLoop() {
+    m_quit = true;
+    if (m_multi) {
+        curl_multi_wakeup(m_multi);
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_multi) {
+        curl_multi_cleanup(m_multi);
+    }
+}
+
+std::future<CURLcode> TransferLoop::Perform(CURL* curl, const CancellationToken& cancellation) {
+    auto request = std::make_unique<Request>();
+    request->curl = curl;
+    request->cancellation = cancellation;
+    std::future<CURLcode> result = request->result.get_future();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopping || cancellation.IsCancelled()) {
+        request->result.set_value(CURLE_ABORTED_BY_CALLBACK);
+        return result;
+    }
+    if (!curl || !EnsureStarted()) {
+        request->result.set_value(CURLE_FAILED_INIT);
+        return result;
+    }
+
+    m_pending.push_back(std::move(request));
+    curl_multi_wakeup(m_multi);
+    return result;
+}
+
+void TransferLoop::AbortAll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+    if (m_multi) {
+        LOG_INFO("Aborting all transfers.");
+
+        curl_multi_wakeup(m_multi);
+    }
+}
+
+void TransferLoop::Resume() {
+    m_stopping = false;
+}
+
+bool TransferLoop::IsStopping() const {
+    return m_stopping;
+}
+
+bool TransferLoop::PauseForBandwidth(CURL* curl, size_t bytes) {
+    BandwidthLimiter& limiter = BandwidthLimiter::Instance();
+    if (std::this_thread::get_id() != m_thread.get_id()) {
+        limiter.Consume(bytes);
+        return false;
+    }
+
+    const Clock::duration wait = limiter.TryConsume(bytes);
+    if (wait == Clock::duration::zero()) {
+        return false;
+    }
+    m_paused.push_back({ curl, Clock::now() + wait });
+    return true;
+}
+
+void TransferLoop::ResumePaused() {
+    const Clock::time_point now = Clock::now();
+    std::vector<CURL*> due;
+    m_paused.erase(std::remove_if(m_paused.begin(), m_paused.end(), [&](const Paused& paused) {
+        if (paused.resumeAt > now) {
+            return false;
+        }
+        due.push_back(paused.curl);
+        return true;
+    }), m_paused.end());
+
+    // Resuming delivers the held chunk right away, which may pause the transfer again
+    for (CURL* curl : due) {
+        curl_easy_pause(curl, CURLPAUSE_CONT);
+    }
+}
+
+int TransferLoop::PollTimeout(bool idle) const {
+    if (idle) {
+        return kIdleTimeoutMs;
+    }
+
+    int timeout = kPollTimeoutMs;
+    const Clock::time_point now = Clock::now();
+    for (const Paused& paused : m_paused) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(paused.resumeAt - now).count();
+        timeout = static_cast<int>(std::clamp<decltype(remaining)>(remaining, 0, timeout));
+    }
+    return timeout;
+}
+
+bool TransferLoop::EnsureStarted() {
+    if (m_thread.joinable()) {
+        return true;
+    }
+
+    m_multi = curl_multi_init();
+    if (!m_multi) {
+        LOG_ERROR("Failed to create the curl multi handle for the transfer loop.");
+
+        return false;
+    }
+    m_thread = std::thread(&TransferLoop::Run, this);
+    return true;
+}
+
+void TransferLoop::Run() {
+    std::vector<std::unique_ptr<Request>> active;
+    auto complete = [&](size_t index, CURLcode result) {
+        CURL* curl = active[index]->curl;
+        m_paused.erase(std::remove_if(m_paused.begin(), m_paused.end(),
+            [curl](const Paused& paused) { return paused.curl == curl; }), m_paused.end());
+        curl_multi_remove_handle(m_multi, curl);
+        active[index]->result.set_value(result);
+        active.erase(active.begin() + static_cast<std::ptrdiff_t>(index));
+    };
+
+    while (!m_quit) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& request : m_pending) {
+                if (curl_multi_add_handle(m_multi, request->curl) != CURLM_OK) {
+                    request->result.set_value(CURLE_FAILED_INIT);
+                    continue;
+                }
+                active.push_back(std::move(request));
+            }
+            m_pending.clear();
+        }
+
+        for (size_t i = active.size(); i-- > 0;) {
+            if (m_stopping || active[i]->cancellation.IsCancelled()) {
+                complete(i, CURLE_ABORTED_BY_CALLBACK);
+            }
+        }
+
+        ResumePaused();
+
+        int running = 0;
+        if (curl_multi_perform(m_multi, &running) != CURLM_OK) {
+            LOG_ERROR("curl_multi_perform failed in the transfer loop.");
+        }
+
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(m_multi, &queued)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL* curl = message->easy_handle;
+            CURLcode result = message->data.result;
+            auto it = std::find_if(active.begin(), active.end(), [curl](const auto& request) { return request->curl == curl; });
+            if (it != active.end()) {
+                complete(static_cast<size_t>(it - active.begin()), result);
+            }
+        }
+
+        curl_multi_poll(m_multi, nullptr, 0, PollTimeout(active.empty()), nullptr);
+    }
+
+    for (size_t i = active.size(); i-- > 0;) {
+        complete(i, CURLE_ABORTED_BY_CALLBACK);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& request : m_pending) {
+        request->result.set_value(CURLE_ABORTED_BY_CALLBACK);
+    }
+    m_pending.clear();
+}
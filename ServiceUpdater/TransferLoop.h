@@ -0,0 +1,122 @@
+#ifndef TRANSFERLOOP_H
+#define TRANSFERLOOP_H
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CancellationToken.h"
+
+/**
+ * @class TransferLoop
+ * @brief Process-wide curl multi event loop that runs transfers on one background thread.
+ *
+ * `Perform()` is the asynchronous counterpart of `curl_easy_perform()`: the easy handle is
+ * added to a shared multi handle and driven by the loop thread together with all other
+ * transfers, and the result is delivered through a future. The thread that started the
+ * transfer is free to wait on the future, do other work, or cancel it.
+ *
+ * The loop checks the cancellation token of every transfer on each iteration and removes
+ * cancelled transfers, completing them with `CURLE_ABORTED_BY_CALLBACK`. `AbortAll()` does
+ * the same for every transfer at once and rejects new ones until `Resume()`; the service
+ * calls it when it is stopped, so a download in progress does not hold up the shutdown.
+ *
+ * The write, header and progress callbacks of the transfers run on the loop thread, so they
+ * must never block it. A write callback throttled by the `BandwidthLimiter` pauses its
+ * transfer with `PauseForBandwidth()` instead of sleeping, and the loop resumes it once the
+ * limiter has tokens again.
+ */
+class TransferLoop {
+public:
+    static TransferLoop& Instance();
+
+    /**
+     * @brief Starts a transfer on the loop thread.
+     *
+     * The handle must stay valid and must not be used by the caller until the future is ready.
+     *
+     * @param curl Easy handle with all options set, as for `curl_easy_perform()`.
+     * @param cancellation Token that aborts the transfer when cancelled.
+     * @return Future of the result of the transfer.
+     */
+    std::future<CURLcode> Perform(CURL* curl, const CancellationToken& cancellation = {});
+
+    /**
+     * @brief Aborts every transfer in progress and rejects new ones until `Resume()`.
+     */
+    void AbortAll();
+
+    /**
+     * @brief Accepts transfers again after `AbortAll()`.
+     */
+    void Resume();
+
+    /**
+     * @brief Returns true between `AbortAll()` and `Resume()`.
+     */
+    [[nodiscard]] bool IsStopping() const;
+
+    /**
+     * @brief Applies the `BandwidthLimiter` to a chunk received by a write callback.
+     *
+     * Called by write callbacks before they handle the chunk. On the loop thread, if the limit
+     * does not allow the chunk yet, the transfer is scheduled to resume once it does and true
+     * is returned; the callback then returns `CURL_WRITEFUNC_PAUSE`, and curl delivers the same
+     * chunk again after the resume. On any other thread the call blocks in
+     * `BandwidthLimiter::Consume()` and returns false.
+     *
+     * @param curl Easy handle of the transfer.
+     * @param bytes Size of the chunk.
+     * @return true if the callback has to pause the transfer.
+     */
+    bool PauseForBandwidth(CURL* curl, size_t bytes);
+
+    TransferLoop(const TransferLoop&) = delete;
+    TransferLoop& operator=(const TransferLoop&) = delete;
+
+private:
+    TransferLoop();
+    ~TransferLoop();
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        CURL* curl = nullptr;
+        CancellationToken cancellation;
+        std::promise<CURLcode> result;
+    };
+
+    /// A transfer paused by the bandwidth limit.
+    struct Paused {
+        CURL* curl = nullptr;
+        Clock::time_point resumeAt;
+    };
+
+    /// Longest time the loop sleeps before it checks the cancellation tokens again.
+    static constexpr int kPollTimeoutMs = 250;
+
+    void Run();
+
+    /// Resumes the paused transfers that are due; loop thread only.
+    void ResumePaused();
+
+    /// Returns how long `curl_multi_poll()` may wait, in milliseconds; loop thread only.
+    int PollTimeout(bool idle) const;
+
+    /// Starts the loop thread if it is not running yet; requires `m_mutex`.
+    bool EnsureStarted();
+
+    mutable std::mutex m_mutex;
+    CURLM* m_multi = nullptr;
+    std::vector<std::unique_ptr<Request>> m_pending;
+    std::vector<Paused> m_paused;  ///< Only used on the loop thread.
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<bool> m_quit{ false };
+    std::thread m_thread;
+};
+
+#endif // TRANSFERLOOP_H
@@ -2,15 +2,22 @@
 #define URLGENERATOR_H
 
 #include "DecryptionManager.h"
+#include "HttpHeaders.h"
+#include "CurlPool.h"
+#include "TransferLoop.h"
+#include "CancellationToken.h"
+#include "PackageSource.h"
+#include <filesystem>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <iostream>
 
 class URLGenerator {
 public:
 
     URLGenerator(const std::string& region, const std::string& customerId, const std::string& siteId, const std::string& blobName)
-        : region(region), customerId(customerId), siteId(siteId), blobName(blobName), sasToken(sasToken) {
+        : region(region), customerId(customerId), siteId(siteId), blobName(blobName) {
 
         // Map of URLs for each region
         regionUrls = {
@@ -173,18 +180,21 @@ public:
      * - Uses a timeout of 10 seconds for the request.
      *
      * @param url The URL to check.
+     * @param headers Optional output for the response headers, filled if the URL exists.
+     * @param cancellation Token that aborts the request.
      * @return true if the URL exists (HTTP 200 response), false otherwise.
      */
-    bool urlExists(const std::string& url) const {
-        CURL* curl = curl_easy_init();
-        if (!curl) {
-            LOG_ERROR("Failed to initialize CURL.");
-
+    bool urlExists(const std::string& url, HttpResponseHeaders* headers = nullptr, const CancellationToken& cancellation = {}) const {
+        CurlHandle handle = CurlPool::Instance().Acquire();
+        if (!handle) {
             return false;
         }
 
+        CURL* curl = handle.get();
+
         bool exists = false;
         CURLcode res;
+        HttpResponseHeaders responseHeaders;
 
         // Configure CURL options for a HEAD request
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
@@ -193,19 +203,23 @@ public:
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);  // Skip SSL certificate validation
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);  // Skip hostname verification
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);  // Set timeout to 10 seconds
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HttpResponseHeaders::HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
 
-        res = curl_easy_perform(curl);
+        res = TransferLoop::Instance().Perform(curl, cancellation).get();
 
         if (res == CURLE_OK) {
             long response_code = 0;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
             exists = (response_code == 200);
+            if (exists && headers) {
+                *headers = std::move(responseHeaders);
+            }
         }
         else {
             std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
         }
 
-        curl_easy_cleanup(curl);
         return exists;
     }
 
@@ -213,12 +227,14 @@ public:
      * @brief Checks if a given URL with `siteId` exists using an HTTP HEAD request.
      *
      * @param url The URL to check for existence.
+     * @param headers Optional output for the response headers, filled if the URL exists.
+     * @param cancellation Token that aborts the request.
      * @return True if the URL exists (returns HTTP 200), otherwise false.
      */
-    bool checkUrlExists(const std::string& url) const {
+    bool checkUrlExists(const std::string& url, HttpResponseHeaders* headers = nullptr, const CancellationToken& cancellation = {}) const {
         // Send a HEAD request to check if the URL exists
         
-        bool exists = urlExists(url);
+        bool exists = urlExists(url, headers, cancellation);
 
         if (exists) {
             //spdlog::info("URL exists: {}", url);
@@ -240,9 +256,14 @@ public:
     /**
      * @brief Main method that checks if the URL with `siteId` exists, and if not, checks the URL without `siteId`.
      *
+     * The headers of the HEAD response for the returned URL are kept and available through
+     * `getValidUrlHeaders()`.
+     *
      * @return The valid URL if one exists, or an empty string if neither URL is valid.
      */
     std::string getValidUrl() {
+        validUrlHeaders.Clear();
+
         // Generate URLs with and without `siteId`
         std::string urlWithSiteId = generateUrlWithSiteId();
         std::string urlWithoutSiteId = generateUrlWithoutSiteId();
@@ -252,13 +273,13 @@ public:
 
 
         // Check if the URL with `siteId` exists
-        if (checkUrlExists(urlWithSiteId)) {
+        if (checkUrlExists(urlWithSiteId, &validUrlHeaders)) {
             //spdlog::info("Valid URL with siteId found: {}", urlWithSiteId);
             return urlWithSiteId;  // Return URL with `siteId` if valid
         }
 
         // Check if the URL without `siteId` exists
-        if (checkUrlExists(urlWithoutSiteId)) {
+        if (checkUrlExists(urlWithoutSiteId, &validUrlHeaders)) {
             //spdlog::info("Valid URL without siteId found: {}", urlWithoutSiteId);
             return urlWithoutSiteId;  // Return URL without `siteId` if valid
         }
@@ -268,13 +289,108 @@ public:
 
         return "";
     }
+
+    /**
+     * @brief Returns the headers of the HEAD response for the URL last returned by `getValidUrl()`.
+     *
+     * For Azure blobs these carry the blob's `Content-Length` and MD5, which lets callers
+     * recognize an unchanged package without downloading it.
+     */
+    const HttpResponseHeaders& getValidUrlHeaders() const {
+        return validUrlHeaders;
+    }
+
+    /**
+     * @brief Lists the sources of the package, in the configured order.
+     *
+     * The primary region comes first, then the secondary regions and the mirrors of the
+     * `PackageSources` configuration. Every source lists the location with `siteId` before
+     * the one without, as `getValidUrl()` checks them. Nothing is requested yet; see `locate()`.
+     */
+    std::vector<PackageSource> getPackageSources(const PackageSourcesConfig& config) const {
+        std::vector<PackageSource> sources;
+        sources.push_back(regionSource(*this));
+
+        for (const std::string& secondary : config.secondaryRegions) {
+            if (secondary == region) {
+                continue;
+            }
+            PackageSource source = regionSource(URLGenerator(secondary, customerId, siteId, blobName));
+            if (!source.candidates.empty()) {
+                sources.push_back(std::move(source));
+            }
+        }
+
+        for (const std::string& mirror : config.mirrors) {
+            PackageSource source;
+            source.name = mirror;
+            if (PackageSource::IsUrl(mirror)) {
+                source.candidates = { mirror + "/" + customerId + "/" + siteId + "/" + blobName, mirror + "/" + customerId + "/" + blobName };
+            }
+            else {
+                source.candidates = { (std::filesystem::path(mirror) / customerId / siteId / blobName).string(),
+                    (std::filesystem::path(mirror) / customerId / blobName).string() };
+            }
+            sources.push_back(std::move(source));
+        }
+        return sources;
+    }
+
+    /**
+     * @brief Finds the first candidate location of a source that has the package.
+     *
+     * URLs are checked with a HEAD request, whose headers are kept in `source.headers`;
+     * file system paths are checked for a regular file.
+     *
+     * @param source The source; `location` is set to the candidate found.
+     * @param cancellation Token that aborts the HEAD requests.
+     * @return true if the source has the package.
+     */
+    bool locate(PackageSource& source, const CancellationToken& cancellation = {}) const {
+        for (const std::string& candidate : source.candidates) {
+            if (cancellation.IsCancelled()) {
+                return false;
+            }
+
+            source.headers.Clear();
+            if (PackageSource::IsUrl(candidate)) {
+                if (checkUrlExists(candidate, &source.headers, cancellation)) {
+                    source.location = candidate;
+                    return true;
+                }
+                continue;
+            }
+
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(candidate, ec)) {
+                source.location = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
 private:
+    /**
+     * @brief Returns the source for the region of a generator, named after the region.
+     */
+    static PackageSource regionSource(const URLGenerator& generator) {
+        PackageSource source;
+        source.name = generator.region;
+        for (const std::string& url : { generator.generateUrlWithSiteId(), generator.generateUrlWithoutSiteId() }) {
+            if (!url.empty()) {
+                source.candidates.push_back(url);
+            }
+        }
+        return source;
+    }
+
     std::string region;
     std::string customerId;
     std::string siteId;
     std::string blobName;
     std::string sasToken;
     mutable std::unordered_map<std::string, bool> urlCache;
+    HttpResponseHeaders validUrlHeaders;  // HEAD response headers of the URL last returned by getValidUrl()
     std::unordered_map<std::string, std::string> regionSasTokens;  // Map of encrypted SAS tokens per region
     std::unordered_map<std::string, std::string> regionUrls;  // Map of region URLs
 };
@@ -2,12 +2,18 @@
 #define UPDATEMANAGER_H
 
 #include "FileMonitor.h"
+#include "HashEngine.h"
 #include "FileDownloader.h"
+#include "SiteCache.h"
+#include "PackageSource.h"
 #include "URLGenerator.h"
 #include "ZipManager.h"
 #include "UpgradePathManager.h"
 #include "WindowsServiceManager.h"
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <future>
 #include <spdlog/spdlog.h>
 
 namespace fs = std::filesystem;
@@ -25,45 +31,40 @@ public:
     /**
      * @brief Initiates the initial installation process by downloading and extracting a ZIP file.
      *
-     * This function attempts to download the installation package from a valid URL,
-     * using optional proxy settings if available. If the installation is required,
-     * the downloaded package is extracted. Otherwise, the downloaded file is deleted.
+     * This function attempts to download the installation package from the first package
+     * source that has it (see `FetchPackage()`), using optional proxy settings if available.
+     * If the installation is required, the downloaded package is extracted. Otherwise, the
+     * downloaded file is deleted.
      *
      * @return true if the installation was successful, false if it was not needed or if an error occurred.
      */
     bool PerformInitialInstallation() {
         try {
-            std::string url = urlGenerator.getValidUrl();
-            if (url.empty()) {
-                LOG_ERROR("No valid URL found for initial installation.");
-
-                return false;
-            }
-
-            UpgradePathManager pathManager;
-            std::string proxyConfig = pathManager.GetProxyFilePath();
-            FileDownloader downloader(url, downloadPath);
-            if (!downloader.downloadWithOptionalProxy(url,downloadPath,proxyConfig)) {
+            DownloadedPackage package;
+            if (!FetchPackage(package, std::nullopt)) {
                 LOG_ERROR("Failed to download the installation file: {}", downloadPath);
 
                 return false;
             }
 
-            bool shouldExtract = configMonitor.InitialInstall();
+            bool shouldExtract = CheckPackageHash(package, true);
+            ShareWithSite(package);
             if (shouldExtract) {
                 LOG_INFO("Initial installation required, extracting...");
 
-                if (!ExtractUpdate()) {
+                if (!ExtractUpdate(package)) {
                     LOG_ERROR("Failed to extract installation package from {}", downloadPath);
 
                     return false;
                 }
+                RecordFetchedPackage(package);
                 return true;
             }
 
             LOG_INFO("Deleting unnecessary ZIP file.");
 
-            fs::remove(downloadPath);
+            DiscardPackage(package);
+            RecordFetchedPackage(package);
             return false;
         }
         catch (const std::exception& e) {
@@ -77,32 +78,39 @@ public:
 
     /**
      * @brief Main update logic: Downloads the ZIP file, checks if it's changed, and extracts if needed.
+     *
+     * The package handled in the previous cycle is recorded with its MD5, length and
+     * validators. If the HEAD request that located the package reports the same MD5 and
+     * length, the cycle ends without a GET. Otherwise the download is conditional on the
+     * recorded `ETag` / `Last-Modified`, and a 304 also ends the cycle right there, without
+     * writing or hashing anything. Small packages are downloaded and extracted in memory
+     * (see `DownloadPackage()`). The package is taken from the first package source that
+     * has it (see `FetchPackage()`).
+     *
      * @return True if update was applied (file extracted), false otherwise.
      */
     bool PerformUpdate() {
         try {
-            std::string url = urlGenerator.getValidUrl();
-            std::cout << url << std::endl;
-            if (url.empty()) {
-                LOG_ERROR("No valid URL found for update");
-
-                return false;
-            }
-
-            FileDownloader downloader(url, downloadPath);
+            auto fetched = PackageFetchRecord::Load(downloadPath);
             /*if (!downloader.download()) {
                 spdlog::error("Failed to download the update file: {}", downloadPath);
                 return false;
             }*/
-            UpgradePathManager pathManager;
-            std::string proxyConfig = pathManager.GetProxyFilePath();
-            if (!downloader.downloadWithOptionalProxy(url, downloadPath, proxyConfig)) {
+            DownloadedPackage package;
+            if (!FetchPackage(package, fetched)) {
                 LOG_ERROR("Failed to download the installation file: {}", downloadPath);
 
                 return false;
             }
 
-            bool shouldExtract = configMonitor.ShouldRestartService();
+            if (package.unchanged) {
+                LOG_INFO("Update package is unchanged since the last cycle. Skipping update.");
+
+                return false;
+            }
+
+            bool shouldExtract = CheckPackageHash(package, false);
+            ShareWithSite(package);
             if (!shouldExtract) {
                 UpgradePathManager path;
 
@@ -110,10 +118,7 @@ public:
                 std::string exe2 = ConvertWStringToString(path.GetService2TargetPath());
                 std::string jsonCheck = path.GetServiceHashFilePath();
 
-                bool exe1Changed = !IsFileUnchanged(exe1, jsonCheck);
-                bool exe2Changed = !IsFileUnchanged(exe2, jsonCheck);
-
-                if (exe1Changed || exe2Changed) {
+                if (!AreFilesUnchanged({ exe1, exe2 }, jsonCheck)) {
                     LOG_INFO("One or more files have changed. Extraction is required.");
                     shouldExtract = true;
                 }
@@ -124,17 +129,19 @@ public:
             if (shouldExtract) {
                 LOG_INFO("New update detected, extracting...");
 
-                if (!ExtractUpdate()) {
+                if (!ExtractUpdate(package)) {
                     LOG_ERROR("Failed to extract update from {}", downloadPath);
 
                     return false;
                 }
+                RecordFetchedPackage(package);
                 return true;
             }
 
             LOG_INFO("Update file is unchanged. Deleting unnecessary ZIP file.");
 
-            fs::remove(downloadPath);
+            DiscardPackage(package);
+            RecordFetchedPackage(package);
             return false;
         }
         catch (const std::exception& e) {
@@ -159,7 +166,8 @@ public:
     /**
      * @brief Cleans the extracted folder by removing all unnecessary files.
      *
-     * This function deletes all extracted files and directories except `service_hashes.json`.
+     * This function deletes all extracted files and directories except the service hash store
+     * (`service_hashes.hashdb`, its journal and any migrated `service_hashes.json`).
      * It ensures that the folder is cleaned up after an update process to avoid conflicts.
      *
      * If the folder does not exist, it logs a warning and skips cleanup.
@@ -177,7 +185,7 @@ public:
 
 
             for (const auto& entry : fs::directory_iterator(extractPath)) {
-                if (entry.path().filename() == "service_hashes.json") {
+                if (entry.path().filename().string().rfind("service_hashes.", 0) == 0) {
                     LOG_INFO("Skipping file: {}", entry.path().string());
 
                     continue;
@@ -204,6 +212,35 @@ private:
         RESTART_ONLY
     };
 
+    /// Number of byte ranges the package is fetched in concurrently.
+    static constexpr int kDownloadSegments = 4;
+
+    /// Default for `InMemoryPackageLimitMB` in `serviceMainConfig.json`.
+    static constexpr uint64_t kDefaultInMemoryPackageLimitMB = 32;
+
+    /// Attempts per transfer on a package source that is followed by another one.
+    static constexpr int kAttemptsBeforeFailover = 2;
+
+    /// Suffix of the destination of the second source in a race.
+    static constexpr const char* kRaceSuffix = ".race";
+
+    /// Size of the chunks a package is copied from a file system mirror in.
+    static constexpr size_t kMirrorChunkSize = 1024 * 1024;
+
+    /**
+     * @brief A downloaded update package: the ZIP file at `downloadPath`, or its content in memory.
+     */
+    struct DownloadedPackage {
+        bool inMemory = false;
+        std::string content;
+        std::optional<std::string> sha256;  ///< SHA-256 computed during the download, if available.
+        bool fromSiteCache = false;         ///< Downloaded from the site cache instead of the cloud.
+        bool unchanged = false;             ///< The package handled in the previous cycle; nothing was downloaded.
+        std::string location;               ///< URL or path of the package on the source it came from.
+        HttpValidators validators;          ///< Validators the source reported for the package.
+        ContentFingerprint fingerprint;     ///< MD5 and length the source reported for the package.
+    };
+
     URLGenerator urlGenerator;
     ConfigFileMonitor configMonitor;
     std::string downloadPath;
@@ -211,63 +248,558 @@ private:
     ZipManager zipManager;
 
     /**
-     * @brief Checks if a file has remained unchanged based on its SHA-256 hash.
+     * @brief Checks if a set of files has remained unchanged based on their SHA-256 hashes.
      *
-     * This function computes the SHA-256 hash of the specified file and compares it
-     * with the previously stored hash in a JSON file. If the file is missing or the
-     * hash does not match, it is considered changed.
+     * This function hashes all files in parallel and compares each hash with the one
+     * previously stored in the JSON hash file. A file that is missing, cannot be hashed, or
+     * whose hash is not recorded or does not match is considered changed.
      *
-     * @param filePath The path to the file being checked.
+     * @param filePaths The paths of the files being checked.
      * @param jsonFilePath The path to the JSON file storing file hashes.
-     * @return true if the file is unchanged, false otherwise.
+     * @return true if every file is unchanged, false otherwise.
      */
-    bool IsFileUnchanged(const std::string& filePath, const std::string& jsonFilePath) {
+    bool AreFilesUnchanged(const std::vector<std::string>& filePaths, const std::string& jsonFilePath) {
         try {
             FileHasher hasher(jsonFilePath);
 
-            if (!fs::exists(filePath)) {
-                LOG_ERROR("File does not exist: {}", filePath);
+            if (hasher.IsStoreEmpty()) {
+                LOG_WARN("Hash store '{}' holds no records.", jsonFilePath);
                 return false;
             }
 
-            auto currentHash = hasher.GetFileSHA256(filePath);
-            if (!currentHash) {
-                LOG_ERROR("Failed to compute hash for file: {}", filePath);
-                return false;
+            std::vector<fs::path> paths(filePaths.begin(), filePaths.end());
+            auto results = hasher.HashFiles(paths);
+
+            bool allUnchanged = true;
+            for (const auto& result : results) {
+                std::string filePath = result.path.string();
+
+                if (!result.sha256) {
+                    LOG_ERROR("Failed to compute hash for file '{}': {}", filePath, result.error);
+                    allUnchanged = false;
+                    continue;
+                }
+
+                auto storedHash = hasher.GetStoredFileHash(filePath);
+                if (!storedHash) {
+                    LOG_WARN("Stored hash not found or invalid for file: {}", filePath);
+                    allUnchanged = false;
+                    continue;
+                }
+
+                LOG_INFO("Computed hash: {}", *result.sha256);
+
+                LOG_INFO("Stored hash: {}", *storedHash);
+
+                if (*result.sha256 == *storedHash) {
+                    LOG_INFO("File '{}' is unchanged.", filePath);
+                }
+                else {
+                    LOG_INFO("File '{}' has changed.", filePath);
+                    allUnchanged = false;
+                }
             }
 
-            if (!fs::exists(jsonFilePath)) {
-                LOG_WARN("JSON file '{}' does not exist.", jsonFilePath);
-                return false;
+            return allUnchanged;
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Exception in AreFilesUnchanged: {}", e.what());
+            return false;
+        }
+        catch (...) {
+            LOG_ERROR("Unknown error in AreFilesUnchanged.");
+            return false;
+        }
+    }
+
+    /**
+     * @brief Remembers the validators of the package that was just handled.
+     *
+     * Called once the package has been applied or found to be unchanged, so a package whose
+     * processing failed is downloaded again in the next cycle.
+     */
+    void RecordFetchedPackage(const DownloadedPackage& package) {
+        if (package.validators.Empty() && package.fingerprint.Empty()) {
+            PackageFetchRecord::Remove(downloadPath);
+            return;
+        }
+
+        PackageFetchRecord record;
+        record.url = UrlWithoutQuery(package.location);
+        record.validators = package.validators;
+        record.content = package.fingerprint;
+        record.Save(downloadPath);
+    }
+
+    /**
+     * @brief Downloads the package from the first package source that has it.
+     *
+     * The sources are the primary region, then the `SecondaryRegions` and `Mirrors` of the
+     * `PackageSources` section of `serviceMainConfig.json` (see `PackageSourcesConfig`), in
+     * that order except that sources which failed recently are tried last (see
+     * `SourceHealth`). While other sources remain, a failing transfer is given up after
+     * `kAttemptsBeforeFailover` attempts, so a degraded endpoint does not hold up the update
+     * with its timeouts and retries; the last source retries as before.
+     *
+     * With `Race` enabled, the first two sources are started at once (see `RacePackage()`).
+     *
+     * @param fetched Record of the package handled in the previous cycle, if any.
+     * @return true if the package was downloaded, or found to be unchanged.
+     */
+    bool FetchPackage(DownloadedPackage& package, const std::optional<PackageFetchRecord>& fetched) {
+        UpgradePathManager pathManager;
+        const PackageSourcesConfig config = PackageSourcesConfig::Load(pathManager.GetMainConfig());
+        std::vector<PackageSource> sources = urlGenerator.getPackageSources(config);
+        SourceHealth::Instance().Order(sources);
+
+        size_t next = 0;
+        if (config.race && sources.size() > 1) {
+            if (IsProxyEnabled(pathManager.GetProxyFilePath())) {
+                LOG_INFO("Package sources are not raced through a proxy; trying them in order.");
             }
+            else {
+                std::optional<size_t> cancelled;
+                if (RacePackage(sources[0], sources[1], fetched, package, cancelled)) {
+                    return true;
+                }
+                next = 2;
+                // The source that lost the race never got to finish; it gets its turn now.
+                if (cancelled && FetchFromSource(sources[*cancelled], fetched, next < sources.size(), {}, downloadPath, package)) {
+                    return true;
+                }
+            }
+        }
 
-            auto storedHash = hasher.GetStoredFileHash(filePath);
-            if (!storedHash) {
-                LOG_WARN("Stored hash not found or invalid for file: {}", filePath);
-                return false;
+        for (size_t i = next; i < sources.size(); ++i) {
+            if (FetchFromSource(sources[i], fetched, i + 1 < sources.size(), {}, downloadPath, package)) {
+                return true;
+            }
+        }
+        LOG_ERROR("The update package could not be downloaded from any of the {} package source(s).", sources.size());
+
+        return false;
+    }
+
+    /**
+     * @brief Downloads the package from two sources at once and keeps the one that delivers first.
+     *
+     * Both sources are located and downloaded concurrently, each to a destination of its own.
+     * The first to receive data, or to finish without needing any, wins and the other is
+     * cancelled right away, so a slow or unresponsive source costs no more time than the
+     * faster one needs and only a few chunks are received twice. A source that fails before
+     * the other delivered anything leaves the race to the other.
+     *
+     * @param cancelled Set to the index (0 or 1) of the cancelled source if the winner failed later on.
+     * @return true if the package was downloaded, or found to be unchanged.
+     */
+    bool RacePackage(PackageSource& first, PackageSource& second, const std::optional<PackageFetchRecord>& fetched,
+        DownloadedPackage& package, std::optional<size_t>& cancelled) {
+        struct Racer {
+            PackageSource* source = nullptr;
+            std::string destination;
+            CancellationToken cancellation;
+            DownloadedPackage package;
+            bool downloaded = false;
+        };
+        std::array<Racer, 2> racers{ Racer{ &first, downloadPath }, Racer{ &second, downloadPath + kRaceSuffix } };
+        std::atomic<int> winner{ -1 };
+        auto claim = [&racers, &winner](int index) {
+            int none = -1;
+            if (winner.compare_exchange_strong(none, index)) {
+                racers[1 - index].cancellation.Cancel();
+            }
+        };
+
+        LOG_INFO("Racing package sources '{}' and '{}'.", first.name, second.name);
+
+        std::array<std::future<bool>, 2> results;
+        for (int i = 0; i < 2; ++i) {
+            results[i] = std::async(std::launch::async, [&, i] {
+                Racer& racer = racers[i];
+                bool fetchedPackage = FetchFromSource(*racer.source, fetched, true, racer.cancellation, racer.destination,
+                    racer.package, [&claim, i](uint64_t received, uint64_t) {
+                        if (received > 0) {
+                            claim(i);
+                        }
+                    });
+                if (fetchedPackage) {
+                    claim(i);
+                }
+                return fetchedPackage;
+            });
+        }
+        for (int i = 0; i < 2; ++i) {
+            racers[i].downloaded = results[i].get();
+        }
+
+        const int won = winner;
+        bool succeeded = won >= 0 && racers[won].downloaded;
+        std::error_code ec;
+        if (succeeded && won == 1) {
+            // The partial download of the first source is of no use any more.
+            PartialDownloadState::Discard(downloadPath);
+            if (!racers[1].package.inMemory && !racers[1].package.unchanged) {
+                fs::rename(racers[1].destination, downloadPath, ec);
+                if (ec) {
+                    LOG_ERROR("Failed to move the package from '{}' to '{}': {}", racers[1].destination, downloadPath, ec.message());
+
+                    succeeded = false;
+                }
             }
+        }
+        PartialDownloadState::Discard(racers[1].destination);
+        fs::remove(racers[1].destination, ec);
+        if (!succeeded) {
+            if (won >= 0) {
+                cancelled = static_cast<size_t>(1 - won);
+            }
+            return false;
+        }
 
-            LOG_INFO("Computed hash: {}", *currentHash);
+        LOG_INFO("Package source '{}' won the race.", racers[won].source->name);
 
-            LOG_INFO("Stored hash: {}", *storedHash);
+        package = std::move(racers[won].package);
+        return true;
+    }
+
+    /**
+     * @brief Locates the package on a source and downloads it from there.
+     *
+     * The outcome is recorded in `SourceHealth`, unless the attempt was cancelled.
+     *
+     * @param hasFallback Whether another source follows; failed transfers then give up early.
+     * @param cancellation Token that aborts the attempt.
+     * @param destination Path the package file is written to.
+     * @param progress Receives the progress of the download.
+     */
+    bool FetchFromSource(PackageSource& source, const std::optional<PackageFetchRecord>& fetched, bool hasFallback,
+        const CancellationToken& cancellation, const std::string& destination, DownloadedPackage& package,
+        const FileDownloader::ProgressCallback& progress = {}) {
+        package = DownloadedPackage();
+        bool fetchedPackage = false;
+        if (!urlGenerator.locate(source, cancellation)) {
+            if (!cancellation.IsCancelled()) {
+                LOG_WARN("Package source '{}' does not have the update package.", source.name);
+            }
+        }
+        else {
+            LOG_INFO("Downloading the update package from package source '{}'.", source.name);
+
+            package.location = source.location;
+            fetchedPackage = source.IsFile()
+                ? CopyFromMirror(source.location, cancellation, destination, package, progress)
+                : DownloadFromUrl(source, fetched, hasFallback, cancellation, destination, package, progress);
+        }
+
+        if (fetchedPackage) {
+            SourceHealth::Instance().RecordSuccess(source.name);
+        }
+        else if (!cancellation.IsCancelled() && !TransferLoop::Instance().IsStopping()) {
+            SourceHealth::Instance().RecordFailure(source.name);
+        }
+        return fetchedPackage;
+    }
+
+    /**
+     * @brief Downloads the package from a source located by URL: a region or an HTTP mirror.
+     *
+     * If the source reports the MD5 and length of the package handled in the previous cycle,
+     * nothing is downloaded and `package.unchanged` is set. If the package was downloaded
+     * from the same URL before, the download is conditional on its validators, and a 304
+     * sets `package.unchanged` as well. Nodes with the `Client` site cache role first try
+     * the site cache (see `DownloadFromSiteCache()`).
+     */
+    bool DownloadFromUrl(const PackageSource& source, const std::optional<PackageFetchRecord>& fetched, bool hasFallback,
+        const CancellationToken& cancellation, const std::string& destination, DownloadedPackage& package,
+        const FileDownloader::ProgressCallback& progress) {
+        const ContentFingerprint remote = source.headers.Fingerprint();
+        if (fetched && !remote.Empty() && remote == fetched->content) {
+            LOG_INFO("Update package matches the last handled one (MD5 {}, {} bytes). Skipping download.",
+                remote.md5, remote.length);
+
+            package.unchanged = true;
+            return true;
+        }
 
-            if (*currentHash == *storedHash) {
-                LOG_INFO("File '{}' is unchanged.", filePath);
+        if (DownloadFromSiteCache(source, cancellation, destination, progress, package)) {
+            return true;
+        }
+
+        FileDownloader downloader(source.location, destination);
+        downloader.setParallelSegments(kDownloadSegments);
+        downloader.setCancellationToken(cancellation);
+        downloader.setProgressCallback(progress);
+        if (hasFallback) {
+            downloader.setRetryPolicy(RetryPolicy(kAttemptsBeforeFailover));
+        }
+        if (fetched && fetched->url == UrlWithoutQuery(source.location)) {
+            downloader.setConditionalValidators(fetched->validators);
+        }
+        if (!DownloadPackage(source, downloader, destination, package)) {
+            return false;
+        }
+
+        package.unchanged = downloader.wasNotModified();
+        package.validators = downloader.getResponseValidators();
+        package.fingerprint = downloader.getResponseFingerprint();
+        if (package.fingerprint.Empty()) {
+            package.fingerprint = remote;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Downloads the update package, into memory if it is small enough.
+     *
+     * A package whose size (from the HEAD request that located it) is at most
+     * `InMemoryPackageLimitMB` of `serviceMainConfig.json` is kept in memory and later
+     * extracted from there, which saves writing it to `zip\`, reading it back and deleting
+     * it. Larger packages, packages of unknown size and downloads through a proxy go to
+     * `destination` as before. A limit of 0 disables in-memory downloads.
+     *
+     * Either way the SHA-256 hash of the package is computed while it is downloaded and kept
+     * in `package.sha256`, so the change check does not have to read the package again.
+     */
+    bool DownloadPackage(const PackageSource& source, FileDownloader& downloader, const std::string& destination, DownloadedPackage& package) {
+        UpgradePathManager pathManager;
+        std::string proxyConfig = pathManager.GetProxyFilePath();
+        const uint64_t limit = LoadInMemoryPackageLimit(pathManager.GetMainConfig());
+        auto size = source.headers.ContentLength();
+        bool proxyEnabled = IsProxyEnabled(proxyConfig);
+
+        package.inMemory = limit > 0 && size && *size <= limit && !proxyEnabled;
+        bool downloaded = false;
+        if (package.inMemory) {
+            LOG_INFO("Downloading the {} byte package into memory.", *size);
+
+            downloaded = downloader.downloadToMemory(package.content, limit);
+        }
+        else {
+            downloaded = downloader.downloadWithOptionalProxy(source.location, destination, proxyConfig);
+        }
+        package.sha256 = downloader.getContentSha256();
+        return downloaded;
+    }
+
+    /**
+     * @brief Copies the package from a mirror on the file system: a local or UNC path.
+     *
+     * Mirrors are trusted like the cloud. The package is hashed while it is copied, and read
+     * into memory under the same limit as downloads (see `DownloadPackage()`).
+     */
+    bool CopyFromMirror(const std::string& path, const CancellationToken& cancellation, const std::string& destination,
+        DownloadedPackage& package, const FileDownloader::ProgressCallback& progress) {
+        UpgradePathManager pathManager;
+        const uint64_t limit = LoadInMemoryPackageLimit(pathManager.GetMainConfig());
+        std::error_code ec;
+        const uint64_t size = fs::file_size(path, ec);
+        if (ec) {
+            LOG_ERROR("Failed to read the size of '{}': {}", path, ec.message());
+
+            return false;
+        }
+
+        package.inMemory = limit > 0 && size <= limit;
+        DownloadSink sink;
+        if (package.inMemory) {
+            package.content.reserve(size);
+        }
+        else if (!sink.Open(destination, 0, true)) {
+            return false;
+        }
+        else if (!sink.Reserve(size)) {
+            sink.Close();
+            fs::remove(destination, ec);
+            return false;
+        }
+
+        ReadOptions options;
+        options.strategy = ReadStrategy::BufferedRead;
+        options.strideSize = kMirrorChunkSize;
+        DigestStream digest;
+        uint64_t copied = 0;
+        bool complete = HashEngine::ForEachChunk(path, [&](const unsigned char* data, size_t chunk) {
+            if (cancellation.IsCancelled() || TransferLoop::Instance().IsStopping()) {
+                return false;
+            }
+            digest.Update(data, chunk);
+            copied += chunk;
+            if (progress) {
+                progress(copied, size);
+            }
+            if (package.inMemory) {
+                package.content.append(reinterpret_cast<const char*>(data), chunk);
                 return true;
             }
+            return sink.Write(data, chunk);
+        }, options);
+        complete = (package.inMemory || sink.Close(true)) && complete && copied == size;
+
+        if (!complete) {
+            LOG_WARN("Failed to copy the package from '{}' ({} of {} bytes).", path, copied, size);
 
-            LOG_INFO("File '{}' has changed.", filePath);
+            package.content = std::string();
+            if (!package.inMemory) {
+                fs::remove(destination, ec);
+            }
             return false;
+        }
+        LOG_INFO("Copied the {} byte package from '{}'.", size, path);
+
+        package.sha256 = digest.Finish();
+        return true;
+    }
 
+    static bool IsProxyEnabled(const std::string& proxyConfig) {
+        return !proxyConfig.empty() && fs::exists(proxyConfig) && Proxy(proxyConfig).isProxyEnabled();
+    }
+
+    /**
+     * @brief Downloads the package from the site cache, for nodes with the `Client` role.
+     *
+     * The package is requested by the MD5 the source reported in the HEAD request that located
+     * it, and verified against that MD5 and length while it is received, so a stale or
+     * tampered copy is never used. The site cache is tried once; if it is unreachable, does
+     * not have the package or sends something else, the package is downloaded from the source.
+     *
+     * @return true if the package was downloaded from the site cache.
+     */
+    bool DownloadFromSiteCache(const PackageSource& source, const CancellationToken& cancellation, const std::string& destination,
+        const FileDownloader::ProgressCallback& progress, DownloadedPackage& package) {
+        UpgradePathManager pathManager;
+        const SiteCacheConfig siteCache = SiteCacheConfig::Load(pathManager.GetMainConfig());
+        if (siteCache.role != SiteCacheRole::Client) {
+            return false;
+        }
+
+        const ContentFingerprint cloud = source.headers.Fingerprint();
+        const std::string siteUrl = siteCache.PackageUrl(cloud);
+        if (siteUrl.empty() || cloud.length == 0) {
+            LOG_WARN("Package source '{}' reported no MD5 for the package; not using the site cache.", source.name);
+
+            return false;
+        }
+
+        LOG_INFO("Downloading the package from the site cache: {}", siteUrl);
+
+        const uint64_t limit = LoadInMemoryPackageLimit(pathManager.GetMainConfig());
+        FileDownloader siteDownloader(siteUrl, destination, 1);
+        siteDownloader.setRetryPolicy(RetryPolicy(1));
+        siteDownloader.setExpectedContent(cloud);
+        siteDownloader.setCancellationToken(cancellation);
+        siteDownloader.setProgressCallback(progress);
+        package.inMemory = limit > 0 && cloud.length <= limit;
+        bool downloaded = package.inMemory ? siteDownloader.downloadToMemory(package.content, limit) : siteDownloader.download();
+        if (!downloaded) {
+            if (!cancellation.IsCancelled()) {
+                LOG_WARN("The site cache could not provide the package; downloading it from package source '{}'.", source.name);
+            }
+
+            package.content = std::string();
+            return false;
+        }
+        package.sha256 = siteDownloader.getContentSha256();
+        package.fromSiteCache = true;
+        package.validators = source.headers.Validators();
+        package.fingerprint = cloud;
+        return true;
+    }
+
+    /**
+     * @brief Hands a verified package to the site cache, on the node with the `Server` role.
+     *
+     * The package is checked against the MD5 and length its source reported before it is
+     * served; see `SiteCacheServer::Publish()`.
+     */
+    void ShareWithSite(const DownloadedPackage& package) {
+        SiteCacheServer& server = SiteCacheServer::Instance();
+        if (!server.IsRunning() || package.fromSiteCache) {
+            return;
+        }
+
+        if (package.inMemory) {
+            server.Publish(package.content, package.fingerprint);
+        }
+        else {
+            server.Publish(fs::path(downloadPath), package.fingerprint);
+        }
+    }
+
+    /**
+     * @brief Reads the in-memory package limit from `serviceMainConfig.json`, in bytes.
+     */
+    static uint64_t LoadInMemoryPackageLimit(const std::string& configFilePath) {
+        uint64_t limitMB = kDefaultInMemoryPackageLimitMB;
+        try {
+            std::ifstream file(configFilePath);
+            if (file.is_open()) {
+                json config = json::parse(file);
+                limitMB = config.value("InMemoryPackageLimitMB", kDefaultInMemoryPackageLimitMB);
+            }
         }
         catch (const std::exception& e) {
-            LOG_ERROR("Exception in IsFileUnchanged for '{}': {}", filePath, e.what());
+            LOG_WARN("Invalid 'InMemoryPackageLimitMB' in '{}': {}", configFilePath, e.what());
+
+        }
+        return limitMB * 1024 * 1024;
+    }
+
+    /**
+     * @brief Runs the change check of the configuration monitor on the downloaded package.
+     *
+     * Uses the hash computed during the download. Only if there is none (e.g. a complete
+     * partial file was found on disk) is the package hashed here.
+     *
+     * @param initialInstall Whether to record the package as the initial state instead.
+     * @return True if the package has to be extracted.
+     */
+    bool CheckPackageHash(const DownloadedPackage& package, bool initialInstall) {
+        if (package.sha256) {
+            return initialInstall ? configMonitor.InitialInstall(*package.sha256) : configMonitor.ShouldRestartService(*package.sha256);
+        }
+        if (!package.inMemory) {
+            return initialInstall ? configMonitor.InitialInstall() : configMonitor.ShouldRestartService();
+        }
+
+        auto hash = HashEngine::DigestBuffer(package.content.data(), package.content.size(), EVP_sha256());
+        if (!hash) {
+            LOG_ERROR("Failed to compute SHA-256 hash of the downloaded package.");
+
             return false;
         }
-        catch (...) {
-            LOG_ERROR("Unknown error in IsFileUnchanged for '{}'.", filePath);
+        return initialInstall ? configMonitor.InitialInstall(*hash) : configMonitor.ShouldRestartService(*hash);
+    }
+
+    /**
+     * @brief Drops a package that does not need to be extracted.
+     */
+    void DiscardPackage(DownloadedPackage& package) {
+        if (package.inMemory) {
+            package.content = std::string();
+            return;
+        }
+        fs::remove(downloadPath);
+    }
+
+    /**
+     * @brief Extracts the downloaded package to the target directory.
+     * @return True if extraction is successful, false otherwise.
+     */
+    bool ExtractUpdate(const DownloadedPackage& package) {
+        if (!package.inMemory) {
+            return ExtractUpdate();
+        }
+
+        if (!zipManager.ExtractArchiveFromMemory(package.content, extractPath)) {
+            LOG_ERROR("Failed to extract the in-memory update package.");
+
             return false;
         }
+
+        LOG_INFO("Successfully extracted update to {}", extractPath);
+
+        configMonitor.AcknowledgeRestart();
+        return true;
     }
 
     /**
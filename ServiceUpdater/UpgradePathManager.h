@@ -17,8 +17,9 @@ public:
         m_zipPath = m_upgradePath + "zip\\";
         m_extractedPath = m_zipPath + "extracted\\";
         m_backupPath = m_zipPath + "backup\\";
-        m_zipHashFilePath = m_zipPath + "zip_hashes.json";
-        m_serviceHashFilePath = m_extractedPath + "service_hashes.json";
+        m_siteCachePath = m_upgradePath + "sitecache\\";
+        m_zipHashFilePath = m_zipPath + "zip_hashes.hashdb";
+        m_serviceHashFilePath = m_extractedPath + "service_hashes.hashdb";
         m_blobName = "ncrv_dcs_streaming_service_upgrade_manager.zip";
         m_zipFilePath = m_zipPath + m_blobName;
         m_loggerConfig = m_configPath + "loggerConfig.json";
@@ -39,7 +40,8 @@ public:
             pathManager.GetExtractedPath(),
             pathManager.GetConfigsDirectory(),
             pathManager.GetLogDirectory(),
-            pathManager.GetBackupPath()
+            pathManager.GetBackupPath(),
+            pathManager.GetSiteCacheDirectory()
         };
 
         for (const auto& dir : directories) {
@@ -103,6 +105,10 @@ public:
         return m_backupPath;
     }
 
+    std::string GetSiteCacheDirectory() const {
+        return m_siteCachePath;
+    }
+
     std::string GetMainConfig() const {
         return m_mainConfig;
     }
@@ -249,6 +255,7 @@ private:
     std::string m_uninstallDir;
     std::string m_controllerConfig;
     std::string m_backupPath;
+    std::string m_siteCachePath;
 
 
 
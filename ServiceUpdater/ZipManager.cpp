@@ -1,4 +1,5 @@
 #include "ZipManager.h"
+#include "ZipLib/utils/stream_utils.h"
 #include <filesystem>
 #include <spdlog/spdlog.h>
 
@@ -170,6 +171,53 @@ bool ZipManager::ExtractArchiveToFolder(const std::string& zipFilename, const st
     }
 }
 
+bool ZipManager::ExtractArchiveFromMemory(const std::string& archiveData, const std::string& outputFolder) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    try {
+        imemstream stream(const_cast<char*>(archiveData.data()), archiveData.size());
+        ZipArchive::Ptr archive = ZipArchive::Create(stream);
+
+        for (size_t i = 0; i < archive->GetEntriesCount(); ++i) {
+            auto entry = archive->GetEntry(static_cast<int>(i));
+            std::string outputPath = outputFolder + "/" + entry->GetFullName();
+
+            if (entry->IsDirectory()) {
+                fs::create_directories(outputPath);
+                continue;
+            }
+
+            std::istream* data = entry->GetDecompressionStream();
+            if (!data) {
+                LOG_ERROR("Failed to read entry '{}' of the in-memory archive.", entry->GetFullName());
+
+                return false;
+            }
+
+            fs::create_directories(fs::path(outputPath).parent_path());
+            std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                LOG_ERROR("Failed to open file for writing: {}", outputPath);
+
+                return false;
+            }
+            utils::stream::copy(*data, file);
+            entry->CloseDecompressionStream();
+
+            if (!file.flush()) {
+                LOG_ERROR("Failed to write file: {}", outputPath);
+
+                return false;
+            }
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Failed to extract in-memory archive: {}", e.what());
+
+        return false;
+    }
+}
+
 void ZipManager::AddFolderToArchive(const std::string& folderPath, ZipArchive::Ptr archive, const std::string& basePath) {
     for (const auto& entry : fs::recursive_directory_iterator(folderPath)) {
         std::string relativePath = fs::relative(entry.path(), basePath).string();
@@ -104,6 +104,18 @@ public:
      */
     bool ExtractArchiveToFolder(const std::string& zipFilename, const std::string& outputFolder);
 
+    /**
+     * @brief Extracts all files from a ZIP archive held in memory into a specified folder.
+     *
+     * The archive is read through a memory stream, so only the extracted entries are written
+     * to disk; the archive itself never is.
+     *
+     * @param archiveData The complete content of the ZIP file.
+     * @param outputFolder The directory where the archive contents will be extracted.
+     * @return true if extraction was successful, false otherwise.
+     */
+    bool ExtractArchiveFromMemory(const std::string& archiveData, const std::string& outputFolder);
+
     /**
      * @brief Zips an entire folder into a ZIP archive.
      *